@@ -0,0 +1,225 @@
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <util/atomic.h>
+#include "adc_scan.h"
+#include "swing_capture.h"
+#include "pins.h"
+
+static void saveAdcScanParameters(void);
+
+struct AdcScanParams {
+    uint16_t conversion_period;
+    uint8_t oversample[ADC_CHANNELS];   // log2 of the visits averaged
+    uint8_t decimation[ADC_CHANNELS];   // rounds between visits
+};
+
+// a round is the angle and pressure, with both vacuums every fourth,
+// about 2.5 conversions or 625us
+static struct AdcScanParams EEMEM saved_params = {
+    .conversion_period = 250,
+    .oversample = {0, 0, 2, 2},
+    .decimation = {1, 1, 4, 4},
+};
+
+static struct AdcScanParams params;
+
+// a conversion takes 104us at the ADC's clk/128
+#define MIN_CONVERSION_PERIOD 125
+// twice the period in Timer1 ticks is 16 bits
+#define MAX_CONVERSION_PERIOD 32767
+// 64 10 bit counts still fit the 16 bit sum
+#define MAX_OVERSAMPLE 6
+#define MAX_DECIMATION 16
+
+static const uint8_t channel_pins[ADC_CHANNELS] = {
+    ANGLE_AI, PRESSURE_AI, VACUUM_AI_LEFT, VACUUM_AI_RIGHT
+};
+
+struct AdcSlot {
+    uint16_t counts;
+    uint32_t time;
+    bool valid;
+};
+
+static volatile struct AdcSlot slots[ADC_CHANNELS];
+static volatile uint16_t sums[ADC_CHANNELS];
+// visits until the average is published, rounds until the next visit
+static volatile uint8_t visits_left[ADC_CHANNELS];
+static volatile uint8_t rounds_left[ADC_CHANNELS];
+static volatile uint8_t converting = ADC_ANGLE;
+static volatile bool capturing = false;
+// the conversion in flight when the mode changed belongs to the old one
+static volatile bool discard = false;
+
+// ADMUX and ADCSRB for an analog pin, AVcc reference as analogRead uses,
+// Timer1 compare B starting each conversion
+static void selectChannel(uint8_t channel) {
+    uint8_t mux = channel_pins[channel] - A0;
+    ADCSRB = (1 << ADTS2) | (1 << ADTS0) | (mux >= 8 ? (1 << MUX5) : 0);
+    ADMUX = (1 << REFS0) | (mux & 7);
+}
+
+// CTC at clk/8, half microsecond ticks
+static void startTimer(uint16_t ticks) {
+    TCCR1A = 0;
+    TCCR1B = (1 << WGM12) | (1 << CS11);
+    OCR1A = ticks - 1;
+    OCR1B = ticks - 1;
+    TCNT1 = 0;
+    TIFR1 = (1 << OCF1B);
+    ADCSRA = (1 << ADEN) | (1 << ADATE) | (1 << ADIE) | (1 << ADIF) |
+             (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+}
+
+static void publish(uint8_t channel, uint16_t counts) {
+    slots[channel].counts = counts;
+    slots[channel].time = micros();
+    slots[channel].valid = true;
+}
+
+// The next channel due. Each channel counts its rounds down and reloads
+// from its decimation, so the interrupt never divides. The angle is due
+// every round, which ends the search within one round.
+static uint8_t nextChannel(uint8_t channel) {
+    while(true) {
+        if(++channel == ADC_CHANNELS) {
+            channel = 0;
+        }
+        if(--rounds_left[channel] == 0) {
+            rounds_left[channel] = params.decimation[channel];
+            return channel;
+        }
+    }
+}
+
+// the interrupt's work for one finished conversion
+static inline void conversionDone(uint16_t counts) {
+    // the trigger is the flag's rising edge, so clear it for the next one
+    TIFR1 = (1 << OCF1B);
+    if(discard) {
+        // the next conversion is still the one the mode change selected
+        discard = false;
+        return;
+    }
+    uint8_t channel = converting;
+    if(capturing) {
+        converting = channel == ADC_ANGLE ? ADC_PRESSURE : ADC_ANGLE;
+    } else {
+        converting = nextChannel(channel);
+    }
+    selectChannel(converting);
+
+    if(capturing) {
+        publish(channel, counts);
+        if(channel == ADC_PRESSURE) {
+            swingCapturePair(slots[ADC_ANGLE].counts, counts);
+        }
+        return;
+    }
+    sums[channel] += counts;
+    if(--visits_left[channel] == 0) {
+        publish(channel, sums[channel] >> params.oversample[channel]);
+        sums[channel] = 0;
+        visits_left[channel] = 1 << params.oversample[channel];
+    }
+}
+
+ISR(ADC_vect) {
+    conversionDone(ADC);
+}
+
+bool adcLatest(uint8_t channel, uint16_t *counts, uint32_t *time) {
+    bool valid;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        *counts = slots[channel].counts;
+        *time = slots[channel].time;
+        valid = slots[channel].valid;
+    }
+    return valid;
+}
+
+void adcScanCapture(uint16_t period) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        capturing = true;
+        discard = (ADCSRA & (1 << ADSC)) != 0;
+        converting = ADC_ANGLE;
+        selectChannel(ADC_ANGLE);
+        // a conversion every half period
+        startTimer(period);
+    }
+}
+
+void adcScanStop(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        TCCR1B = 0;
+        ADCSRA = (1 << ADEN) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+        ADCSRB = 0;
+    }
+    // let a conversion in flight finish before analogRead starts its own
+    while(ADCSRA & (1 << ADSC));
+}
+
+void adcScanResume(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        capturing = false;
+        discard = (ADCSRA & (1 << ADSC)) != 0;
+        for(uint8_t c = 0; c < ADC_CHANNELS; c++) {
+            sums[c] = 0;
+            visits_left[c] = 1 << params.oversample[c];
+            rounds_left[c] = 1;
+        }
+        converting = ADC_ANGLE;
+        selectChannel(ADC_ANGLE);
+        startTimer(2 * params.conversion_period);
+    }
+}
+
+void adcScanBenchmarkStep(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        conversionDone(ADC);
+    }
+}
+
+static void clampParameters(void) {
+    if(params.conversion_period < MIN_CONVERSION_PERIOD) {
+        params.conversion_period = MIN_CONVERSION_PERIOD;
+    } else if(params.conversion_period > MAX_CONVERSION_PERIOD) {
+        params.conversion_period = MAX_CONVERSION_PERIOD;
+    }
+    for(uint8_t c = 0; c < ADC_CHANNELS; c++) {
+        if(params.oversample[c] > MAX_OVERSAMPLE) {
+            params.oversample[c] = MAX_OVERSAMPLE;
+        }
+        if(params.decimation[c] < 1) {
+            params.decimation[c] = 1;
+        } else if(params.decimation[c] > MAX_DECIMATION) {
+            params.decimation[c] = MAX_DECIMATION;
+        }
+    }
+    params.decimation[ADC_ANGLE] = 1;
+}
+
+void setAdcScanParameters(uint16_t conversion_period,
+                          const uint8_t (&oversample)[ADC_CHANNELS],
+                          const uint8_t (&decimation)[ADC_CHANNELS]) {
+    params.conversion_period = conversion_period;
+    for(uint8_t c = 0; c < ADC_CHANNELS; c++) {
+        params.oversample[c] = oversample[c];
+        params.decimation[c] = decimation[c];
+    }
+    clampParameters();
+    saveAdcScanParameters();
+    if(!capturing) {
+        adcScanResume();
+    }
+}
+
+static void saveAdcScanParameters(void) {
+    eeprom_write_block(&params, &saved_params, sizeof(struct AdcScanParams));
+}
+
+void restoreAdcScanParameters(void) {
+    eeprom_read_block(&params, &saved_params, sizeof(struct AdcScanParams));
+    clampParameters();
+    adcScanResume();
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+
+// The ADC runs free on Timer1 compare B, one conversion a period, round
+// robin over the analog sensors, and the interrupt leaves each channel's
+// newest value and its time in a slot. Reading a sensor is a copy out of
+// its slot, nothing waits on a conversion and analogRead must not be
+// used while the scan runs. Each channel is visited every decimation'th
+// round and averages 2^oversample visits per value. The angle is in every
+// round, the swing and retract loops poll it.
+enum AdcChannel {
+    ADC_ANGLE = 0,
+    ADC_PRESSURE,
+    ADC_VACUUM_LEFT,
+    ADC_VACUUM_RIGHT,
+    ADC_CHANNELS
+};
+
+// counts and the micros() of the last conversion in them, false until the
+// channel has a value
+bool adcLatest(uint8_t channel, uint16_t *counts, uint32_t *time);
+
+// Swing capture, angle and pressure alternately, a pair every period
+// microseconds and no oversampling, each pair handed to
+// swingCapturePair. Resume goes back to the scan.
+void adcScanCapture(uint16_t period);
+void adcScanResume(void);
+// hands the ADC back to analogRead until the next resume
+void adcScanStop(void);
+
+// One conversion's interrupt work, less the interrupt entry and exit, for
+// the cycle benchmark. Interrupts stay off so the real one cannot
+// interleave.
+void adcScanBenchmarkStep(void);
+
+// conversion period in microseconds, at least 125
+void setAdcScanParameters(uint16_t conversion_period,
+                          const uint8_t (&oversample)[ADC_CHANNELS],
+                          const uint8_t (&decimation)[ADC_CHANNELS]);
+// also starts the scan
+void restoreAdcScanParameters(void);
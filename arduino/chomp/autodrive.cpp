@@ -4,14 +4,18 @@
 #include "utils.h"
 #include "imu.h"
 #include "telem.h"
+#include "fixed.h"
+#include "gyro_history.h"
 
 static void saveDriveControlParameters();
 
 struct DriveControlParams {
     int32_t steer_p;
     int32_t steer_d;
+    int32_t rate_max;
+    int32_t rate_p;
+    int32_t rate_i;
     int32_t steer_max;
-    int32_t gyro_gain;
     int32_t drive_p;
     int32_t drive_d;
     int32_t drive_max;
@@ -19,10 +23,12 @@ struct DriveControlParams {
 } __attribute__((packed));
 
 static struct DriveControlParams EEMEM saved_params = {
-    .steer_p = 3000,
+    .steer_p = 1024,
     .steer_d = 0,
+    .rate_max = 8192,
+    .rate_p = 800,
+    .rate_i = 0,
     .steer_max = 600,
-    .gyro_gain = 0,
     .drive_p = 1500,
     .drive_d = 0,
     .drive_max = 600,
@@ -30,19 +36,42 @@ static struct DriveControlParams EEMEM saved_params = {
 };
 
 static struct DriveControlParams params;
+
+// gain formats, chosen so the products below land on whole command units
+typedef Fixed<int16_t, 8> BearingGain;     // radian/s per radian
+typedef Fixed<int16_t, 8> BearingRateGain; // radian/s per radian/s
+typedef Fixed<int16_t, 3> SteerRateGain;   // command per radian/s
+typedef Fixed<int16_t, 3> SteerGain;       // command per radian
+typedef Fixed<int16_t, 12> DriveGain;      // command per mm
+typedef Fixed<int16_t, 10> DriveRateGain;  // command per mm/s
+typedef Fixed<int32_t, 0> Command;
+// mm*4 keeps the squares below within 32 bits
+typedef Fixed<int32_t, 2> Range;
+// radians of accumulated yaw rate error, finer than Radians so a 10ms step
+// of a small error still counts
+typedef Fixed<int32_t, 13> RateIntegral;
 static uint32_t last_autodrive_telem = 0;
 
+// cascade state, the setpoint is held between LEDDAR frames
+static RadiansPerSec rate_setpoint;
+static RateIntegral rate_integral;
+static uint32_t last_gyro_time = 0;
+
 void setDriveControlParams(int16_t p_steer_p,
                            int16_t p_steer_d,
+                           int16_t p_rate_max,
+                           int16_t p_rate_p,
+                           int16_t p_rate_i,
                            int16_t p_steer_max,
-                           int16_t p_gyro_gain,
                            int16_t p_drive_p,
                            int16_t p_drive_d,
                            int16_t p_drive_max
                            ) {
     params.steer_p = p_steer_p;
     params.steer_d = p_steer_d;
-    params.gyro_gain = p_gyro_gain;
+    params.rate_max = p_rate_max;
+    params.rate_p = p_rate_p;
+    params.rate_i = p_rate_i;
     params.steer_max = p_steer_max;
     params.drive_p = p_drive_p;
     params.drive_d = p_drive_d;
@@ -50,62 +79,102 @@ void setDriveControlParams(int16_t p_steer_p,
     saveDriveControlParameters();
 }
 
-int32_t integer_sqrt(int32_t n)
-{
-    int shift = 0;
-    do
-    {
-        shift += 2;
-    }
-    while((n>>shift) > 0 && shift<32);
-    shift -= 2;
+// Outer loop, on LEDDAR frames: bearing to the target and its rate give
+// the yaw rate to turn at, positive to the left like the bearing.
+static void bearingLoop(Radians theta, RadiansPerSec vtheta) {
+    RadiansPerSec rate = theta.mul<RadiansPerSec>(
+        BearingGain::fromRaw(params.steer_p));
+    rate += vtheta.mul<RadiansPerSec>(BearingRateGain::fromRaw(params.steer_d));
+    rate_setpoint = RadiansPerSec::fromRaw(
+        clip(rate.raw(), -params.rate_max, params.rate_max));
+}
 
-    int32_t result=0, candidateResult;
-    while(shift >= 0)
-    {
-        result <<= 1;
-        candidateResult = result + 1;
-        if((candidateResult * candidateResult) <= (n>>shift))
-            result = candidateResult;
-        shift -= 2;
+// Inner loop, every call: PI on the gyro's yaw rate against the setpoint.
+// The integral only moves on a new gyro sample and is held to what
+// steer_max can use, so it does not wind up while the drive is saturated.
+// Returns true when a new sample came in.
+static bool rateLoop(RadiansPerSec *error, int16_t *steer_bias) {
+    int16_t omega_z = 0;
+    getOmegaZ(&omega_z);
+    *error = rate_setpoint - RadiansPerSec::fromRaw(((int32_t)omega_z * 35) / 16);
+
+    uint32_t gyro_time;
+    bool fresh = lastGyroTime(&gyro_time) && gyro_time != last_gyro_time;
+    if(fresh) {
+        // 16us steps keep error*dt inside 32 bits, 50ms covers a stall
+        uint32_t dt = gyro_time - last_gyro_time;
+        if(dt > 50000) {
+            dt = 50000;
+        }
+        last_gyro_time = gyro_time;
+        rate_integral += RateIntegral::fromRaw(
+            error->raw() * (int32_t)(dt >> 4) / 15625L);
+        if(params.rate_i > 0) {
+            int32_t limit = (params.steer_max << 16) / params.rate_i;
+            rate_integral = RateIntegral::fromRaw(
+                clip(rate_integral.raw(), -limit, limit));
+        }
     }
-    return result;
+
+    Command u = error->mul<Command>(SteerRateGain::fromRaw(params.rate_p));
+    u += rate_integral.mul<Command>(SteerGain::fromRaw(params.rate_i));
+    *steer_bias = clip((-u).raw(), -params.steer_max, params.steer_max);
+    return fresh;
 }
 
-bool pidSteer(const Track &tracked_object,
-              int16_t depth, int16_t *drive_bias, int16_t *steer_bias) {
-    int32_t now=micros();
+// Cascaded steering and range keeping on the tracked object. The bearing
+// loop only runs when new_frame is set, the gyro loop every call. Returns
+// true when the biases should go out to the drive: a valid track and
+// either a new frame or a new gyro sample.
+bool pidSteer(const Track &tracked_object, int16_t depth, bool new_frame,
+              int16_t *drive_bias, int16_t *steer_bias) {
+    uint32_t now=micros();
     bool valid = tracked_object.valid(now);
-    if(valid) {
-        int32_t bias;
-        int32_t theta = tracked_object.angle();
-        int32_t vtheta = tracked_object.vtheta();
-        bias  = params.steer_p * (0 - theta) / 16384L;
-        bias += -params.steer_d * vtheta / 16384L;
-        int16_t omegaZ = 0;
-        if(getOmegaZ(&omegaZ)) {
-            bias += -params.gyro_gain*omegaZ/1024;
-        }
-        *steer_bias  = clip(bias, -params.steer_max, params.steer_max);
-        int32_t tracked_r = integer_sqrt(
-            (tracked_object.x / 4L) * (tracked_object.x / 4L) +
-            (tracked_object.y / 4L) * (tracked_object.y / 4L));
-        int32_t tracked_vr = integer_sqrt(
-            (tracked_object.vx / 4L) * (tracked_object.vx / 4L)+
-            (tracked_object.vy / 4L) * (tracked_object.vy / 4L));
-        bias  = params.drive_p * ((int32_t)depth*4L - tracked_r)/16384L;
-        bias += -params.drive_d * tracked_vr * 4 / 16384L;
-        *drive_bias  = clip(bias, -params.drive_max, params.drive_max);
-        if(now - last_autodrive_telem > params.autodrive_telem_interval) {
-            sendAutodriveTelemetry(*steer_bias,
-                                   *drive_bias,
-                                   clip(theta, -32768L, 32767L),
-                                   clip(vtheta, -32768L, 32767L),
-                                   clip(tracked_r / 4, -32768L, 32767L),
-                                   clip(tracked_vr / 4, -32768L, 32767L));
-        }
+    if(!valid) {
+        // start over when a target comes back, from the newest gyro sample
+        rate_setpoint = RadiansPerSec();
+        rate_integral = RateIntegral();
+        lastGyroTime(&last_gyro_time);
+        return false;
+    }
+    Radians theta = tracked_object.angle();
+    RadiansPerSec vtheta = tracked_object.vtheta();
+    if(new_frame) {
+        bearingLoop(theta, vtheta);
+    }
+    RadiansPerSec rate_error;
+    bool fresh = rateLoop(&rate_error, steer_bias);
+
+    Command bias;
+    Range x = Range::from(tracked_object.x);
+    Range y = Range::from(tracked_object.y);
+    Range tracked_r = Range::fromRaw(fixedSqrt(
+        (uint32_t)(x.raw()*x.raw()) + (uint32_t)(y.raw()*y.raw())));
+    MillimetersPerSec rvx, rvy;
+    tracked_object.relativeVelocity(&rvx, &rvy);
+    Range vx = Range::from(rvx);
+    Range vy = Range::from(rvy);
+    Range tracked_vr = Range::fromRaw(fixedSqrt(
+        (uint32_t)(vx.raw()*vx.raw()) + (uint32_t)(vy.raw()*vy.raw())));
+    bias  = (Range::fromInt(depth) - tracked_r).mul<Command>(
+        DriveGain::fromRaw(params.drive_p));
+    bias -= tracked_vr.mul<Command>(
+        DriveRateGain::fromRaw(params.drive_d));
+    *drive_bias  = clip(bias.raw(), -params.drive_max, params.drive_max);
+    if(now - last_autodrive_telem > params.autodrive_telem_interval) {
+        last_autodrive_telem = now;
+        sendAutodriveTelemetry(*steer_bias,
+                               *drive_bias,
+                               theta.raw(),
+                               clip(vtheta.raw(), -32768L, 32767L),
+                               clip(tracked_r.toInt(), -32768L, 32767L),
+                               clip(tracked_vr.toInt(), -32768L, 32767L),
+                               clip(rate_setpoint.raw(), -32768L, 32767L),
+                               clip(rate_error.raw(), -32768L, 32767L),
+                               clip(rate_integral.raw() >> 2,
+                                    -32768L, 32767L));
     }
-    return valid;
+    return new_frame || fresh;
 }
 
 void saveDriveControlParameters() {
@@ -2,7 +2,10 @@
 #include "autofire.h"
 #include "imu.h"
 #include "telem.h"
-#include "hold_down.h"
+#include "weapons.h"
+#include "fixed_math.h"
+#include "strike_timer.h"
+#include "shadow_log.h"
 
 extern uint8_t HAMMER_INTENSITIES_ANGLE[9];
 
@@ -24,10 +27,114 @@ static struct AutofireParameters EEMEM saved_params = {
 
 static void saveAutofireParameters(void);
 
-int32_t swingDuration(int16_t hammer_intensity) {
+// How far past the swing the strike solver looks. Longer than a LEDDAR
+// frame, so the next frame solves again before an arming runs out, and
+// inside the strike timer's reach. A multiple of 32 for strikeTime.
+// The lead plus the horizon must stay under MAX_STRIKE_LEAD, the longest
+// Track::lookahead projects (Seconds is Q15 in an int16_t), or the
+// projection would stop short. A swing and the waits before the throw
+// valve longer than MAX_STRIKE_LEAD - STRIKE_HORIZON is not solved at all.
+#define STRIKE_HORIZON 100000L
+#define MAX_STRIKE_LEAD 999999L
+#define STRIKE_ONE (1L << 15)
+
+// Time from the throw valve opening to the strike at each hammer
+// intensity, learned from the swings' angle traces, so armed and unarmed
+// swings measure the same thing. An intensity never measured uses the
+// hand fit cubic. Durations are in 16us ticks, counts stop at
+// SWING_AVERAGE_WINDOW so the average follows pressure and wear.
+#define SWING_AVERAGE_WINDOW 8
+// swings outside this are a sensor glitch or a stall, ms. The longest
+// leaves the default hold delay and vent lead room under MAX_STRIKE_LEAD.
+#define MIN_LEARNED_SWING 100
+#define MAX_LEARNED_SWING 500
+
+struct SwingDurations {
+    uint16_t duration[9];
+    uint8_t count[9];
+};
+
+static struct SwingDurations swing_durations;
+static struct SwingDurations EEMEM saved_swing_durations;
+
+// 230 + 3(40 - angle)^3/1024 ms
+static uint16_t cubicSwingDuration(int16_t hammer_intensity) {
     int16_t hammer_angle = HAMMER_INTENSITIES_ANGLE[hammer_intensity];
     int32_t x=(40L-hammer_angle);
-    return 230L + (3L*x*x*x)/1024L;
+    return (230L + (3L*x*x*x)/1024L) * 125 / 2;
+}
+
+// microseconds
+int32_t swingDuration(int16_t hammer_intensity) {
+    return swing_durations.duration[hammer_intensity] * 16L;
+}
+
+// Microseconds from the first sample of an angle trace to where it first
+// reaches strike_angle, interpolated between samples, -1 if it never does.
+int32_t traceStrikeTime(const uint16_t *angle_data, uint16_t num_samples,
+                        uint16_t sample_period, uint16_t strike_angle) {
+    for(uint16_t i = 1; i < num_samples; i++) {
+        int32_t before = angle_data[i - 1];
+        int32_t after = angle_data[i];
+        if(after >= strike_angle && before < strike_angle) {
+            return (i - 1) * (int32_t)sample_period +
+                   (strike_angle - before) * sample_period / (after - before);
+        }
+    }
+    return -1;
+}
+
+// Fold a measured swing, microseconds, into the intensity's average.
+// Returns false for a swing outside the plausible range.
+bool learnSwingDuration(int16_t hammer_intensity, int32_t duration) {
+    if(duration < MIN_LEARNED_SWING * 1000L ||
+       duration > MAX_LEARNED_SWING * 1000L) {
+        return false;
+    }
+    int32_t average = swing_durations.duration[hammer_intensity];
+    int32_t step = (duration + 8) / 16 - average;
+    uint8_t count = swing_durations.count[hammer_intensity];
+    if(count < SWING_AVERAGE_WINDOW) {
+        count++;
+    }
+    // rounded, so the average does not stall short of the swings
+    step += step < 0 ? -(count / 2) : count / 2;
+    uint16_t learned = average + step / count;
+    swing_durations.duration[hammer_intensity] = learned;
+    swing_durations.count[hammer_intensity] = count;
+    // only this entry, EEPROM writes take 3.3ms a byte
+    eeprom_write_block(&learned,
+                       &saved_swing_durations.duration[hammer_intensity],
+                       sizeof(learned));
+    eeprom_write_block(&count, &saved_swing_durations.count[hammer_intensity],
+                       sizeof(count));
+    return true;
+}
+
+void resetSwingDurations(void) {
+    for(int16_t i = 0; i < 9; i++) {
+        swing_durations.duration[i] = cubicSwingDuration(i);
+        swing_durations.count[i] = 0;
+    }
+    eeprom_write_block(&swing_durations, &saved_swing_durations,
+                       sizeof(struct SwingDurations));
+}
+
+void restoreSwingDurations(void) {
+    eeprom_read_block(&swing_durations, &saved_swing_durations,
+                      sizeof(struct SwingDurations));
+    for(int16_t i = 0; i < 9; i++) {
+        if(swing_durations.count[i] == 0 ||
+           swing_durations.count[i] > SWING_AVERAGE_WINDOW) {
+            swing_durations.duration[i] = cubicSwingDuration(i);
+            swing_durations.count[i] = 0;
+        }
+    }
+}
+
+bool sendSwingDurations(void) {
+    return sendSwingDurationTelemetry(swing_durations.duration,
+                                      swing_durations.count);
 }
 
 bool omegaZLockout(int32_t *omegaZ) {
@@ -38,38 +145,84 @@ bool omegaZLockout(int32_t *omegaZ) {
     return imu_valid && abs(*omegaZ)>params.max_omegaZ;
 }
 
-int8_t nsteps=3;
-enum AutofireState willHit(const Track &tracked_object,
-                           int16_t depth, int16_t hammer_intensity,
-                           bool auto_hold) {
+// Narrow [*enter, *exit], fractions of the way from a0 to a1 in Q15, to
+// where lo < a < hi.
+static void clipToSlab(int32_t a0, int32_t a1, int32_t lo, int32_t hi,
+                       int32_t *enter, int32_t *exit) {
+    if(a0 == a1) {
+        if(a0 <= lo || a0 >= hi) {
+            *enter = STRIKE_ONE;
+            *exit = 0;
+        }
+        return;
+    }
+    int32_t t_lo = fixedDivide(lo - a0, a1 - a0, 15);
+    int32_t t_hi = fixedDivide(hi - a0, a1 - a0, 15);
+    if(t_lo > t_hi) {
+        int32_t t = t_lo;
+        t_lo = t_hi;
+        t_hi = t;
+    }
+    if(t_lo > *enter) *enter = t_lo;
+    if(t_hi < *exit) *exit = t_hi;
+}
+
+// Microseconds from now until a swing started then, taking lead to land,
+// finds the target inside the strike box (0 < x < depth, |y| < ytol). 0
+// when a swing now lands in the box, -1 when none does within
+// STRIKE_HORIZON. The target's path over the horizon is taken as the
+// chord between the lookaheads at its ends. *px, *py get the position a
+// swing now would land on.
+int32_t strikeTime(const Track &track, int32_t lead, RadiansPerSec omegaZ,
+                   int16_t depth, Millimeters *px, Millimeters *py) {
+    Millimeters x1, y1;
+    track.lookahead(lead, omegaZ, px, py);
+    track.lookahead(lead + STRIKE_HORIZON, omegaZ, &x1, &y1);
+    int32_t enter = 0, exit = STRIKE_ONE;
+    int32_t box_y = Millimeters::fromInt(params.ytol).raw();
+    clipToSlab(px->raw(), x1.raw(), 0, Millimeters::fromInt(depth).raw(),
+               &enter, &exit);
+    clipToSlab(py->raw(), y1.raw(), -box_y, box_y, &enter, &exit);
+    if(enter > exit) {
+        return -1;
+    }
+    // enter*STRIKE_HORIZON/2^15 without overflowing
+    return (enter * (STRIKE_HORIZON / 32)) >> 10;
+}
+
+// Solve for the strike each LEDDAR frame and arm the strike timer for it,
+// or cancel an arming the frame no longer supports.
+enum AutofireState scheduleAutofire(const Track &tracked_object,
+                                    int16_t depth, int16_t hammer_intensity,
+                                    bool auto_hold) {
     int32_t omegaZ=0;
     uint32_t now = micros();
-    bool hit = false;
     bool lockout = omegaZLockout(&omegaZ);
     bool valid = tracked_object.valid(now);
     int32_t swing = 0;
-    int32_t x=0, y=0;
+    int32_t strike = -1;
+    Millimeters x, y;
     if(valid && !lockout) {
-        swing=swingDuration(hammer_intensity)*1000;
-        if(auto_hold)
-        {
-            swing += getAutoholdStartDelay();
+        swing = swingDuration(hammer_intensity) + throwValveDelay(now, auto_hold);
+        if(swing <= MAX_STRIKE_LEAD - STRIKE_HORIZON) {
+            strike = strikeTime(tracked_object, swing,
+                                RadiansPerSec::fromRaw(omegaZ), depth, &x, &y);
         }
-        x=tracked_object.x;
-        y=tracked_object.y;
-        int32_t dt=swing/nsteps;
-        for(int s=0;s<nsteps;s++) {
-            tracked_object.project(dt, dt*omegaZ/1000000, &x, &y);
-        }
-        hit = (x>0) && (x/16<depth) && abs(y/16)<params.ytol;
     }
     enum AutofireState st;
-    if(lockout) st =     AF_OMEGAZ_LOCKOUT;
-    else if(!valid) st = AF_NO_TARGET;
-    else if(!hit) st =   AF_NO_HIT;
-    else st =            AF_HIT;
+    if(lockout) st =        AF_OMEGAZ_LOCKOUT;
+    else if(!valid) st =    AF_NO_TARGET;
+    else if(strike < 0) st = AF_NO_HIT;
+    else if(strike == 0) st = AF_HIT;
+    else st =               AF_ARMED;
+    if(strike >= 0) {
+        armStrikeTimer(strike);
+    } else {
+        cancelStrikeTimer();
+    }
+    shadowLogFrame(now, st, hammer_intensity, swing, strike, x, y);
     if(now - last_autofire_telem > params.autofire_telem_interval) {
-        sendAutofireTelemetry(st, swing, x/16, y/16);
+        sendAutofireTelemetry(st, swing, strike, x.toInt(), y.toInt());
     }
     return st;
 }
@@ -91,4 +244,5 @@ void saveAutofireParameters(void) {
 
 void restoreAutofireParameters(void) {
     eeprom_read_block(&params, &saved_params, sizeof(struct AutofireParameters));
+    restoreSwingDurations();
 }
@@ -6,12 +6,24 @@ enum AutofireState {
     AF_NO_TARGET = 0,
     AF_OMEGAZ_LOCKOUT,
     AF_NO_HIT,
-    AF_HIT
+    AF_HIT,
+    AF_ARMED
 };
 
-enum AutofireState willHit(const Track &tracked_object,
-                           int16_t depth, int16_t hammer_intensity,
-                           bool auto_hold);
+int32_t swingDuration(int16_t hammer_intensity);
+int32_t traceStrikeTime(const uint16_t *angle_data, uint16_t num_samples,
+                        uint16_t sample_period, uint16_t strike_angle);
+bool learnSwingDuration(int16_t hammer_intensity, int32_t duration);
+void resetSwingDurations(void);
+void restoreSwingDurations(void);
+bool sendSwingDurations(void);
+
+int32_t strikeTime(const Track &track, int32_t lead, RadiansPerSec omegaZ,
+                   int16_t depth, Millimeters *px, Millimeters *py);
+
+enum AutofireState scheduleAutofire(const Track &tracked_object,
+                                    int16_t depth, int16_t hammer_intensity,
+                                    bool auto_hold);
 
 bool omegaZLockout(int16_t *omegaZ);
 
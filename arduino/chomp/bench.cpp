@@ -0,0 +1,249 @@
+#include <Arduino.h>
+#include <avr/wdt.h>
+#include "bench.h"
+#include "pins.h"
+#include "fast_pins.h"
+#include "telem.h"
+#include "targeting.h"
+#include "fixed_math.h"
+#include "autofire.h"
+#include "swing_crossing.h"
+#include "adc_scan.h"
+
+// keeps the compiler from discarding benchmark results
+static volatile int32_t bench_sink;
+
+// Two objects, a near one on the left and a far one on the right
+static void cannedFrame(Detection (&detections)[LEDDAR_SEGMENTS]) {
+    static const int16_t distance[LEDDAR_SEGMENTS] = {
+        500, 500, 150, 148, 147, 149, 500, 500,
+        500, 500, 320, 318, 321, 500, 500, 500 };
+    for(uint8_t i = 0; i < LEDDAR_SEGMENTS; i++) {
+        detections[i].Segment = i;
+        detections[i].Distance = distance[i];
+        detections[i].Amplitude = 100 + 10*i;
+    }
+}
+
+// A far object partly hidden by a nearer one, with a third object in
+// front of the near one and one running off the right edge
+static void cannedOccludedFrame(Detection (&detections)[LEDDAR_SEGMENTS]) {
+    static const int16_t distance[LEDDAR_SEGMENTS] = {
+        500, 320, 318, 150, 148, 80, 82, 149, 321, 319,
+        500, 500, 210, 212, 208, 211 };
+    for(uint8_t i = 0; i < LEDDAR_SEGMENTS; i++) {
+        detections[i].Segment = i;
+        detections[i].Distance = distance[i];
+        detections[i].Amplitude = 100 + 10*i;
+    }
+}
+
+// One LEDDAR frame as processed by chompLoop: segmentation, tracking and
+// the calculated object and tracking telemetry conversions.
+static void frameFeatures(const Detection (&detections)[LEDDAR_SEGMENTS],
+                          TrackPool &pool) {
+    Object objects[8];
+    uint32_t now = micros();
+    uint8_t num_objects = segmentObjects(detections, now, objects);
+    int8_t best = trackObjects(now, objects, num_objects, pool);
+    int32_t sink = 0;
+    for(uint8_t i = 0; i < num_objects; i++) {
+        sink += objects[i].Radius + objects[i].Angle.raw() +
+                objects[i].X.raw() + objects[i].Y.raw();
+    }
+    if(best >= 0) {
+        sink += objects[best].X.raw() + objects[best].Y.raw() +
+                objects[best].Angle.raw() + objects[best].Radius;
+    }
+    bench_sink = sink;
+}
+
+// The same frame, recomputing the object features at every point the
+// previous code recomputed angle/radius/x/y: size check, selection,
+// distanceSq for each candidate, the track update and both telemetry
+// packets.
+static void frameRecompute(const Detection (&detections)[LEDDAR_SEGMENTS],
+                           TrackPool &pool) {
+    Object objects[8];
+    uint32_t now = micros();
+    uint8_t num_objects = segmentObjects(detections, now, objects);
+    for(uint8_t i = 0; i < num_objects; i++) {
+        // selection, distanceSq, object telemetry
+        objects[i].computeFeatures();
+        objects[i].computeFeatures();
+        objects[i].computeFeatures();
+    }
+    int8_t best = trackObjects(now, objects, num_objects, pool);
+    if(best >= 0) {
+        // track update, tracking telemetry
+        objects[best].computeFeatures();
+        objects[best].computeFeatures();
+    }
+    bench_sink = best;
+}
+
+// Worst case for the track pool: four live world frame tracks and eight
+// detections, all inside each other's gates.
+static void setupCrowd(TrackPool &pool, Object (&objects)[8]) {
+    for(uint8_t o = 0; o < 8; o++) {
+        objects[o].X = Millimeters::fromInt(800 + 60*o);
+        objects[o].Y = Millimeters::fromInt(200 - 50*o);
+        objects[o].Radius = 800 + 60*o;
+        objects[o].Time = micros();
+    }
+    for(uint8_t t = 0; t < MAX_TRACKS; t++) {
+        pool.tracks[t].world_frame = true;
+        pool.tracks[t].update(objects[2*t]);
+    }
+}
+
+void runBenchmark(uint8_t benchmark, uint16_t iterations) {
+    // benchmarks block the main loop, never run them with weapons enabled
+    if(g_enabled || iterations == 0) {
+        return;
+    }
+    Detection detections[LEDDAR_SEGMENTS];
+    cannedFrame(detections);
+    Track track;
+    TrackPool pool;
+    Object object;
+    object.SumDistance = 600;
+    object.SumIntensity = 400;
+    object.SumAngleIntensity = 2200;
+    object.LeftEdge = 4;
+    object.RightEdge = 8;
+    object.VisibleSegments = 4;
+    Detection occluded[LEDDAR_SEGMENTS];
+    cannedOccludedFrame(occluded);
+    Object objects[8];
+    TrackPool crowd;
+    Object crowd_objects[8];
+    setupCrowd(crowd, crowd_objects);
+    Track alpha_beta;
+    Track kalman;
+    kalman.kalman = true;
+    Object step_object = crowd_objects[0];
+    uint32_t step_time = micros();
+    Track world = track;
+    world.world_frame = true;
+    track.x = world.x = Millimeters::fromInt(400);
+    track.y = world.y = Millimeters::fromInt(-100);
+    track.vx = world.vx = MillimetersPerSec::fromInt(-800);
+    Millimeters x, y;
+    // mid swing at 3000 deg/s, polled every 2ms
+    AngleSamples swing_samples = {};
+    for(uint8_t s = 0; s < CROSSING_SAMPLES; s++) {
+        addAngleSample(swing_samples, 1000000UL + 2000UL*s, 60 + 6*s);
+    }
+    uint32_t crossing;
+    bool adc = benchmark == BENCH_ADC_SCAN_CONVERSION ||
+               benchmark == BENCH_ANALOG_READ;
+    if(adc) {
+        adcScanStop();
+    }
+
+    uint32_t start = micros();
+    for(uint16_t i = 0; i < iterations; i++) {
+        wdt_reset();
+        switch(benchmark) {
+            case BENCH_FRAME_FEATURES:
+                frameFeatures(detections, pool);
+                break;
+            case BENCH_FRAME_RECOMPUTE:
+                frameRecompute(detections, pool);
+                break;
+            case BENCH_COMPUTE_FEATURES:
+                object.computeFeatures();
+                bench_sink = object.X.raw();
+                break;
+            case BENCH_SEGMENT:
+                bench_sink = segmentObjects(occluded, start, objects);
+                break;
+            case BENCH_LOOKAHEAD_BODY:
+                track.lookahead(250000, RadiansPerSec::fromRaw(i), &x, &y);
+                bench_sink = x.raw();
+                break;
+            case BENCH_LOOKAHEAD_WORLD:
+                world.lookahead(250000, RadiansPerSec::fromRaw(i), &x, &y);
+                bench_sink = x.raw();
+                break;
+            case BENCH_TRACK_POOL:
+                for(uint8_t o = 0; o < 8; o++) {
+                    crowd_objects[o].Time = micros();
+                }
+                bench_sink = crowd.update(micros(), crowd_objects, 8,
+                                          MillimetersPerSec(), false);
+                break;
+            case BENCH_TRACK_ALPHA_BETA:
+            case BENCH_TRACK_KALMAN: {
+                Track &t = benchmark == BENCH_TRACK_KALMAN ? kalman : alpha_beta;
+                step_time += 20000;
+                step_object.Time = step_time;
+                step_object.X = Millimeters::fromRaw(16000 + (i & 255));
+                t.predict(step_time, Radians::fromRaw(3));
+                t.update(step_object);
+                bench_sink = t.x.raw();
+                break;
+            }
+            case BENCH_PREDICT_AT:
+                bench_sink = world.predictAt(micros()).x.raw();
+                break;
+            case BENCH_STRIKE_TIME:
+                bench_sink = strikeTime(track, 300000, RadiansPerSec::fromRaw(i),
+                                        600, &x, &y);
+                break;
+            case BENCH_FIXED_SIN:
+                bench_sink = fixedSin(i*7);
+                break;
+            case BENCH_FIXED_ATAN2:
+                bench_sink = fixedAtan2(i*25L - 200000L, 300000L - i*13L);
+                break;
+            case BENCH_FIXED_SQRT:
+                bench_sink = fixedSqrt(i*65537UL);
+                break;
+            case BENCH_FIXED_DIVIDE:
+                bench_sink = fixedDivide(i*3L + 1, 100000L - i, 11);
+                break;
+            case BENCH_DIVIDE:
+                bench_sink = (i*3L + 1)*2048L/(100000L - i);
+                break;
+            case BENCH_FLOAT_SIN:
+                bench_sink = 16384*sin(i*7/2048.0);
+                break;
+            case BENCH_FLOAT_ATAN2:
+                bench_sink = 2048*atan2(i*25L - 200000L, 300000L - i*13L);
+                break;
+            // weapons are disabled so these pins are already low
+            case BENCH_DIGITAL_WRITE:
+                digitalWrite(THROW_VALVE_DO, LOW);
+                break;
+            case BENCH_FAST_WRITE:
+                fastDigitalWrite<THROW_VALVE_DO>(LOW);
+                break;
+            case BENCH_DIGITAL_WRITE_EXTENDED:
+                digitalWrite(VACUUM_VALVE_DO, LOW);
+                break;
+            case BENCH_FAST_WRITE_EXTENDED:
+                fastDigitalWrite<VACUUM_VALVE_DO>(LOW);
+                break;
+            case BENCH_PREDICT_CROSSING:
+                predictCrossing(swing_samples, 150 + (i & 63), &crossing);
+                bench_sink = crossing;
+                break;
+            case BENCH_ADC_SCAN_CONVERSION:
+                adcScanBenchmarkStep();
+                break;
+            case BENCH_ANALOG_READ:
+                bench_sink = analogRead(ANGLE_AI);
+                break;
+            default:
+                break;
+        }
+    }
+    uint32_t elapsed = micros() - start;
+    if(adc) {
+        adcScanResume();
+    }
+    sendBenchmarkTelemetry(benchmark, iterations,
+                           elapsed * (F_CPU / 1000000L) / iterations);
+}
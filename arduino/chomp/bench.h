@@ -0,0 +1,48 @@
+#pragma once
+#include <stdint.h>
+
+// On target cycle benchmarks, run on command with weapons disabled and
+// reported in TLM_ID_BENCH as cycles per iteration.
+enum Benchmark {
+    BENCH_EMPTY = 0,
+    BENCH_FRAME_FEATURES = 1,
+    BENCH_FRAME_RECOMPUTE = 2,
+    BENCH_COMPUTE_FEATURES = 3,
+    // fixed point kernels, with the libm/divide equivalents as reference
+    BENCH_FIXED_SIN = 4,
+    BENCH_FIXED_ATAN2 = 5,
+    BENCH_FIXED_SQRT = 6,
+    BENCH_FIXED_DIVIDE = 7,
+    BENCH_DIVIDE = 8,
+    BENCH_FLOAT_SIN = 9,
+    BENCH_FLOAT_ATAN2 = 10,
+    BENCH_SEGMENT = 11,
+    // strike position lookahead, closed form body frame vs world frame
+    BENCH_LOOKAHEAD_BODY = 12,
+    BENCH_LOOKAHEAD_WORLD = 13,
+    // track pool assignment, 4 tracks and 8 objects all gated together
+    BENCH_TRACK_POOL = 14,
+    // one 20ms predict and update, alpha-beta vs Kalman
+    BENCH_TRACK_ALPHA_BETA = 15,
+    BENCH_TRACK_KALMAN = 16,
+    // loop rate extrapolation of the primary track
+    BENCH_PREDICT_AT = 17,
+    // strike time solve, two body frame lookaheads and the box
+    BENCH_STRIKE_TIME = 18,
+    // a LOW write to an idle valve, Arduino vs compile time port access,
+    // on an I/O space port (throw valve, PORTG) and an extended one
+    // (vacuum valve, PORTK)
+    BENCH_DIGITAL_WRITE = 19,
+    BENCH_FAST_WRITE = 20,
+    BENCH_DIGITAL_WRITE_EXTENDED = 21,
+    BENCH_FAST_WRITE_EXTENDED = 22,
+    // valve crossing time from the last four swing samples
+    BENCH_PREDICT_CROSSING = 23,
+    // the ADC scan's work per conversion with the stored parameters, and
+    // the blocking analogRead of the angle it replaced, scan stopped for
+    // both
+    BENCH_ADC_SCAN_CONVERSION = 24,
+    BENCH_ANALOG_READ = 25,
+};
+
+void runBenchmark(uint8_t benchmark, uint16_t iterations);
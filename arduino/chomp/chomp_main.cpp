@@ -18,6 +18,13 @@
 #include "autodrive.h"
 #include "autofire.h"
 #include "hold_down.h"
+#include "strike_timer.h"
+#include "shadow_log.h"
+#include "valve_timer.h"
+#include "swing_capture.h"
+#include "swing_recorder.h"
+#include "retract_profile.h"
+#include "adc_scan.h"
 
 uint32_t start_time, loop_speed_min, loop_speed_avg, loop_speed_max, loop_count;
 void reset_loop_stats(void) {
@@ -41,6 +48,9 @@ static uint32_t last_sensor_time = micros();
 static int16_t steer_bias = 0; // positive turns left, negative turns right
 static int16_t drive_bias = 0;
 static bool new_autodrive = false;
+// what the wheels were last told, by drive() or by the RC with targeting off
+static int16_t sent_left_drive = 0;
+static int16_t sent_right_drive = 0;
 static enum AutofireState autofire = AF_NO_TARGET;
 
 extern uint16_t leddar_overrun;
@@ -52,7 +62,7 @@ uint32_t sensor_period=5000L;
 uint32_t leddar_max_request_period=100000L;
 
 // parameters written in command
-Track tracked_object;
+TrackPool track_pool;
 
 void chompSetup() {
     // Come up safely
@@ -66,14 +76,21 @@ void chompSetup() {
     sensorSetup();
     holdDownSafe();
     initializeIMU();
+    strikeTimerInit();
+    valveTimerInit();
     reset_loop_stats();
     restoreDriveControlParameters();
+    restoreEgoMotionParameters();
     restoreObjectSegmentationParameters();
-    tracked_object.restoreTrackingFilterParams();
+    track_pool.restoreTrackingFilterParams();
     restoreAutofireParameters();
     restoreSelfRightParameters();
     restoreTelemetryParameters();
     restoreHoldDownParameters();
+    restoreValveTimingParameters();
+    restoreSwingCaptureParameters();
+    restoreRetractParameters();
+    restoreAdcScanParameters();
     debug_print("STARTUP");
     start_time = micros();
 }
@@ -102,7 +119,8 @@ void chompLoop() {
     int16_t hammer_distance = getRange();
     bool targeting_enabled = getTargetingEnable();
     // Check if data is available from the LEDDAR
-    if (bufferDetections()){
+    bool leddar_frame = bufferDetections();
+    if (leddar_frame){
 
         uint32_t now = micros();
         // extract detections from LEDDAR packet
@@ -119,44 +137,71 @@ void chompLoop() {
         Object objects[8];
         uint8_t num_objects = segmentObjects(*minDetections, now, objects);
 
-        int8_t best_object = trackObject(now, objects, num_objects, tracked_object);
-
-        // auto centering code
-        new_autodrive = pidSteer(tracked_object, 
-                                 drive_range, &drive_bias, &steer_bias);
-
-
-        bool auto_hold = current_rc_bitfield & AUTO_HOLD_DOWN;
-        autofire = willHit(tracked_object, hammer_distance, hammer_intensity,
-                           auto_hold);
-        if((autofire==AF_HIT) && (current_rc_bitfield & AUTO_HAMMER_ENABLE_BIT)) {
-            fire(hammer_intensity, current_rc_bitfield & FLAME_PULSE_BIT, true,
-                 auto_hold);
-        }
+        int8_t best_object = trackObjects(now, objects, num_objects, track_pool);
+        const Track &tracked_object = track_pool.primaryTrack();
 
         // Send subsampled leddar telem
         if (isTimeToSendLeddarTelem(now)){
             sendLeddarTelem(*minDetections, raw_detection_count);
             sendObjectsTelemetry(num_objects, objects);
 
-            if(num_objects > 0)
+            Millimeters track_x, track_y;
+            MillimetersPerSec track_vx, track_vy;
+            tracked_object.bodyPosition(&track_x, &track_y);
+            tracked_object.bodyVelocity(&track_vx, &track_vy);
+            uint8_t valid_tracks = track_pool.numValid(now);
+            if(best_object >= 0)
             {
                 sendTrackingTelemetry(
-                        objects[best_object].xcoord(), objects[best_object].ycoord(),
-                        objects[best_object].angle(), objects[best_object].radius(),
-                        tracked_object.x/16, tracked_object.vx/16,
-                        tracked_object.y/16, tracked_object.vy/16);
+                        objects[best_object].X.toInt(),
+                        objects[best_object].Y.toInt(),
+                        objects[best_object].Angle.raw(),
+                        objects[best_object].Radius,
+                        track_x.toInt(), track_vx.toInt(),
+                        track_y.toInt(), track_vy.toInt(),
+                        track_pool.primary, valid_tracks,
+                        getEgoVelocity(now).toInt());
             }
             else
             {
                 sendTrackingTelemetry(
                         0, 0, 0, 0,
-                        tracked_object.x/16, tracked_object.vx/16,
-                        tracked_object.y/16, tracked_object.vy/16);
+                        track_x.toInt(), track_vx.toInt(),
+                        track_y.toInt(), track_vy.toInt(),
+                        track_pool.primary, valid_tracks,
+                        getEgoVelocity(now).toInt());
             }
+            sendTrackQualityTelemetry(track_pool.primary,
+                                      tracked_object.innovations);
+            track_pool.clearInnovations();
         }
     }
 
+    // Steer every loop from the primary track extrapolated to now. The
+    // bearing loop runs on new frames and the gyro loop on every new gyro
+    // sample, drive commands go out on either and on new RC packets
+    uint32_t decision_time = micros();
+    Track current = track_pool.primaryTrack().predictAt(
+        decision_time, getEgoVelocity(decision_time));
+    if(pidSteer(current, drive_range, leddar_frame, &drive_bias, &steer_bias)) {
+        new_autodrive = true;
+    }
+
+    // Solve for the strike on each frame, the strike timer marks the instant
+    bool auto_hold = current_rc_bitfield & AUTO_HOLD_DOWN;
+    if(leddar_frame) {
+        autofire = scheduleAutofire(current, hammer_distance, hammer_intensity,
+                                    auto_hold);
+    }
+    preArm((autofire == AF_ARMED || autofire == AF_HIT) &&
+           (current_rc_bitfield & AUTO_HAMMER_ENABLE_BIT),
+           current_rc_bitfield & FLAME_PULSE_BIT, auto_hold);
+    if(strikeTimerExpired() && (current_rc_bitfield & AUTO_HAMMER_ENABLE_BIT)) {
+        shadowLogFire(micros(), hammer_intensity, true);
+        fire(hammer_intensity, current_rc_bitfield & FLAME_PULSE_BIT, true,
+             auto_hold);
+    }
+
     // React to RC state changes (change since last time this call was made)
     int16_t diff = getRcBitfieldChanges();
     if( !(current_rc_bitfield & FLAME_PULSE_BIT) && !(current_rc_bitfield & FLAME_CTRL_BIT) ){
@@ -176,12 +221,14 @@ void chompLoop() {
     }
     // Manual hammer fire
     if( (diff & HAMMER_FIRE_BIT) && (current_rc_bitfield & HAMMER_FIRE_BIT)){
+        shadowLogFire(micros(), hammer_intensity, false);
         if (current_rc_bitfield & DANGER_CTRL_BIT){
           noAngleFire(hammer_intensity, current_rc_bitfield & FLAME_PULSE_BIT);
         } else {
           fire(hammer_intensity, current_rc_bitfield & FLAME_PULSE_BIT, false /*autofire*/,
                current_rc_bitfield & AUTO_HOLD_DOWN);
         }
+        cancelStrikeTimer();
     }
     if( (diff & HAMMER_RETRACT_BIT) && (current_rc_bitfield & HAMMER_RETRACT_BIT)){
       if (current_rc_bitfield & DANGER_CTRL_BIT){
@@ -213,9 +260,18 @@ void chompLoop() {
             right_drive_value -= steer_bias + drive_bias;
             // values passed by reference to capture clamping
             drive(left_drive_value, right_drive_value);
+            sent_left_drive = left_drive_value;
+            sent_right_drive = right_drive_value;
         }
         new_autodrive = false;
     }
+    // with targeting on the wheels follow the last drive() command, raw RC
+    // is only what they do when the RC drives them directly
+    if(!targeting_enabled) {
+        sent_left_drive = left_drive_value;
+        sent_right_drive = right_drive_value;
+    }
+    updateEgoMotion(micros(), sent_left_drive, sent_right_drive);
 
 
     // read IMU and compute orientation
@@ -255,6 +311,9 @@ void chompLoop() {
     if(isTimeToSendDriveTelemetry(now)) {
         driveTelem();
     }
+    shadowLogDumpStep(now);
+    swingDownloadStep(now);
+    swingTelemStep(now);
 
 
     handle_commands();
@@ -7,6 +7,14 @@
 #include "imu.h"
 #include "selfright.h"
 #include "hold_down.h"
+#include "bench.h"
+#include "drive.h"
+#include "shadow_log.h"
+#include "valve_timer.h"
+#include "swing_capture.h"
+#include "swing_recorder.h"
+#include "retract_profile.h"
+#include "adc_scan.h"
 
 #define MAXIMUM_COMMAND_LENGTH 64
 enum Commands {
@@ -19,9 +27,18 @@ enum Commands {
     CMD_ID_SRT = 16,
     CMD_ID_LDDR = 17,
     CMD_ID_HLD = 18,
+    CMD_ID_BENCH = 19,
+    CMD_ID_EGO = 20,
+    CMD_ID_SWGT = 21,
+    CMD_ID_SHDW = 22,
+    CMD_ID_VLV = 23,
+    CMD_ID_SCAP = 24,
+    CMD_ID_SWREC = 25,
+    CMD_ID_RTRT = 26,
+    CMD_ID_ADCS = 27,
 };
 
-extern Track tracked_object;
+extern TrackPool track_pool;
 
 const uint16_t CMD_TERMINATOR=0x6666;
 
@@ -63,8 +80,10 @@ typedef CommandPacket<CMD_ID_AF, AutoFireInner> AutoFireCommand;
 struct AutoDriveInner {
     int16_t steer_p;
     int16_t steer_d;
+    int16_t rate_max;
+    int16_t rate_p;
+    int16_t rate_i;
     int16_t steer_max;
-    int16_t gyro_gain;
     int16_t drive_p;
     int16_t drive_d;
     int16_t drive_max;
@@ -79,6 +98,11 @@ struct TrackingFilterInner {
     uint32_t track_lost_dt;
     int16_t max_off_track;
     int16_t max_start_distance;
+    uint8_t world_frame:1;
+    uint8_t kalman:1;
+    int16_t accel_noise;
+    int16_t measurement_noise;
+    uint8_t gate;
 } __attribute__((packed));
 typedef CommandPacket<CMD_ID_TRKFLT, TrackingFilterInner> TrackingFilterCommand;
 
@@ -92,6 +116,7 @@ struct IMUParameterInner {
     int16_t max_total_norm;
     int16_t x_threshold;
     int16_t z_threshold;
+    uint32_t gyro_period;
 } __attribute__((packed));
 typedef CommandPacket<CMD_ID_IMUP, IMUParameterInner> IMUParameterCommand;
 
@@ -110,6 +135,10 @@ typedef CommandPacket<CMD_ID_SRT, SelfRightCommandInner> SelfRightCommand;
 struct LeddarCommandInner {
     uint16_t min_detection_distance;
     uint16_t max_detection_distance;
+    int16_t field_of_view;
+    uint8_t segments;
+    int16_t mount_offset;
+    uint8_t upside_down:1;
 } __attribute__((packed));
 typedef CommandPacket<CMD_ID_LDDR, LeddarCommandInner> LeddarCommand;
 
@@ -119,6 +148,64 @@ struct HoldDownCommandInner {
 } __attribute__((packed));
 typedef CommandPacket<CMD_ID_HLD, HoldDownCommandInner> HoldDownCommand;
 
+struct BenchmarkCommandInner {
+    uint8_t benchmark;
+    uint16_t iterations;
+} __attribute__((packed));
+typedef CommandPacket<CMD_ID_BENCH, BenchmarkCommandInner> BenchmarkCommand;
+
+struct EgoMotionCommandInner {
+    int16_t full_speed;
+    int16_t time_constant;
+} __attribute__((packed));
+typedef CommandPacket<CMD_ID_EGO, EgoMotionCommandInner> EgoMotionCommand;
+
+struct SwingDurationCommandInner {
+    uint8_t reset;
+} __attribute__((packed));
+typedef CommandPacket<CMD_ID_SWGT, SwingDurationCommandInner> SwingDurationCommand;
+
+struct ShadowLogCommandInner {
+    uint8_t clear;
+} __attribute__((packed));
+typedef CommandPacket<CMD_ID_SHDW, ShadowLogCommandInner> ShadowLogCommand;
+
+struct ValveTimingCommandInner {
+    uint16_t throw_latency;
+    uint16_t vent_latency;
+    uint8_t predict;
+    uint16_t vent_lead;
+    uint8_t pre_arm;
+} __attribute__((packed));
+typedef CommandPacket<CMD_ID_VLV, ValveTimingCommandInner> ValveTimingCommand;
+
+struct SwingCaptureCommandInner {
+    uint16_t sample_period;
+    uint8_t decimation;
+} __attribute__((packed));
+typedef CommandPacket<CMD_ID_SCAP, SwingCaptureCommandInner> SwingCaptureCommand;
+
+struct SwingRecordCommandInner {
+    uint16_t sequence;
+} __attribute__((packed));
+typedef CommandPacket<CMD_ID_SWREC, SwingRecordCommandInner> SwingRecordCommand;
+
+struct RetractCommandInner {
+    uint16_t full_speed;
+    uint16_t decel;
+    uint16_t min_command;
+    uint8_t gain;
+    uint16_t period;
+} __attribute__((packed));
+typedef CommandPacket<CMD_ID_RTRT, RetractCommandInner> RetractCommand;
+
+struct AdcScanCommandInner {
+    uint16_t conversion_period;
+    uint8_t oversample[ADC_CHANNELS];
+    uint8_t decimation[ADC_CHANNELS];
+} __attribute__((packed));
+typedef CommandPacket<CMD_ID_ADCS, AdcScanCommandInner> AdcScanCommand;
+
 
 static uint8_t command_buffer[MAXIMUM_COMMAND_LENGTH];
 static size_t command_length=0;
@@ -157,6 +244,15 @@ void handle_commands(void) {
   SelfRightCommand *srt_cmd;
   LeddarCommand *leddar_cmd;
   HoldDownCommand *holddown_cmd;
+  BenchmarkCommand *bench_cmd;
+  EgoMotionCommand *ego_cmd;
+  SwingDurationCommand *swgt_cmd;
+  ShadowLogCommand *shdw_cmd;
+  ValveTimingCommand *vlv_cmd;
+  SwingCaptureCommand *scap_cmd;
+  SwingRecordCommand *swrec_cmd;
+  RetractCommand *rtrt_cmd;
+  AdcScanCommand *adcs_cmd;
   if(command_ready) {
       last_command = command_buffer[0];
       switch(last_command) {
@@ -172,12 +268,17 @@ void handle_commands(void) {
               break;
           case CMD_ID_TRKFLT:
               trkflt_cmd = (TrackingFilterCommand *)command_buffer;
-              tracked_object.setTrackingFilterParams(trkflt_cmd->inner.alpha,
+              track_pool.setTrackingFilterParams(trkflt_cmd->inner.alpha,
                                       trkflt_cmd->inner.beta,
                                       trkflt_cmd->inner.min_num_updates,
                                       trkflt_cmd->inner.track_lost_dt,
                                       trkflt_cmd->inner.max_off_track,
-                                      trkflt_cmd->inner.max_start_distance);
+                                      trkflt_cmd->inner.max_start_distance,
+                                      trkflt_cmd->inner.world_frame,
+                                      trkflt_cmd->inner.kalman,
+                                      trkflt_cmd->inner.accel_noise,
+                                      trkflt_cmd->inner.measurement_noise,
+                                      trkflt_cmd->inner.gate);
               valid_command++;
               break;
           case CMD_ID_OBJSEG:
@@ -201,8 +302,10 @@ void handle_commands(void) {
               adrv_cmd = (AutoDriveCommand *)command_buffer;
               setDriveControlParams(adrv_cmd->inner.steer_p,
                                     adrv_cmd->inner.steer_d,
+                                    adrv_cmd->inner.rate_max,
+                                    adrv_cmd->inner.rate_p,
+                                    adrv_cmd->inner.rate_i,
                                     adrv_cmd->inner.steer_max,
-                                    adrv_cmd->inner.gyro_gain,
                                     adrv_cmd->inner.drive_p,
                                     adrv_cmd->inner.drive_d,
                                     adrv_cmd->inner.drive_max);
@@ -218,7 +321,8 @@ void handle_commands(void) {
                     imup_cmd->inner.max_valid_cross,
                     imup_cmd->inner.max_total_norm,
                     imup_cmd->inner.x_threshold,
-                    imup_cmd->inner.z_threshold);
+                    imup_cmd->inner.z_threshold,
+                    imup_cmd->inner.gyro_period);
               valid_command++;
               break;
           case CMD_ID_SRT:
@@ -237,13 +341,78 @@ void handle_commands(void) {
           case CMD_ID_LDDR:
               leddar_cmd = (LeddarCommand *)command_buffer;
               setLeddarParameters(leddar_cmd->inner.min_detection_distance,
-                                  leddar_cmd->inner.max_detection_distance);
+                                  leddar_cmd->inner.max_detection_distance,
+                                  leddar_cmd->inner.field_of_view,
+                                  leddar_cmd->inner.segments,
+                                  leddar_cmd->inner.mount_offset,
+                                  leddar_cmd->inner.upside_down);
               break;
           case CMD_ID_HLD:
               holddown_cmd = (HoldDownCommand *)command_buffer;
               setHoldDownParameters(holddown_cmd->inner.sample_period,
                                     holddown_cmd->inner.start_delay);
               break;
+          case CMD_ID_BENCH:
+              bench_cmd = (BenchmarkCommand *)command_buffer;
+              runBenchmark(bench_cmd->inner.benchmark,
+                           bench_cmd->inner.iterations);
+              valid_command++;
+              break;
+          case CMD_ID_EGO:
+              ego_cmd = (EgoMotionCommand *)command_buffer;
+              setEgoMotionParameters(ego_cmd->inner.full_speed,
+                                     ego_cmd->inner.time_constant);
+              valid_command++;
+              break;
+          case CMD_ID_SWGT:
+              swgt_cmd = (SwingDurationCommand *)command_buffer;
+              if(swgt_cmd->inner.reset) {
+                  resetSwingDurations();
+              }
+              sendSwingDurations();
+              valid_command++;
+              break;
+          case CMD_ID_SHDW:
+              shdw_cmd = (ShadowLogCommand *)command_buffer;
+              startShadowLogDump(shdw_cmd->inner.clear);
+              valid_command++;
+              break;
+          case CMD_ID_VLV:
+              vlv_cmd = (ValveTimingCommand *)command_buffer;
+              setValveTimingParameters(vlv_cmd->inner.throw_latency,
+                                       vlv_cmd->inner.vent_latency,
+                                       vlv_cmd->inner.predict,
+                                       vlv_cmd->inner.vent_lead,
+                                       vlv_cmd->inner.pre_arm);
+              valid_command++;
+              break;
+          case CMD_ID_SCAP:
+              scap_cmd = (SwingCaptureCommand *)command_buffer;
+              setSwingCaptureParameters(scap_cmd->inner.sample_period,
+                                        scap_cmd->inner.decimation);
+              valid_command++;
+              break;
+          case CMD_ID_SWREC:
+              swrec_cmd = (SwingRecordCommand *)command_buffer;
+              startSwingDownload(swrec_cmd->inner.sequence);
+              valid_command++;
+              break;
+          case CMD_ID_RTRT:
+              rtrt_cmd = (RetractCommand *)command_buffer;
+              setRetractParameters(rtrt_cmd->inner.full_speed,
+                                   rtrt_cmd->inner.decel,
+                                   rtrt_cmd->inner.min_command,
+                                   rtrt_cmd->inner.gain,
+                                   rtrt_cmd->inner.period);
+              valid_command++;
+              break;
+          case CMD_ID_ADCS:
+              adcs_cmd = (AdcScanCommand *)command_buffer;
+              setAdcScanParameters(adcs_cmd->inner.conversion_period,
+                                   adcs_cmd->inner.oversample,
+                                   adcs_cmd->inner.decimation);
+              valid_command++;
+              break;
           default:
               invalid_command++;
               break;
@@ -3,10 +3,28 @@
 #include "drive.h"
 #include "pins.h"
 #include "telem.h"
+#include "utils.h"
+#include "fixed_math.h"
 
 // Serial out pins defined in chomp.ino-- check there to verify proper connectivity to motor controllers
 extern HardwareSerial& DriveSerial;
 
+struct EgoMotionParameters {
+    int16_t full_speed;     // mm/s forward at a command of 1000, 0 disables
+    int16_t time_constant;  // ms for the speed to follow a command change
+} __attribute__((packed));
+
+static struct EgoMotionParameters ego_params;
+
+static struct EgoMotionParameters EEMEM saved_ego_params = {
+    .full_speed = 0,
+    .time_constant = 300
+};
+
+static MillimetersPerSec ego_velocity;
+static MillimetersPerSec commanded_velocity;
+static uint32_t last_ego_update;
+
 void driveSetup() {
     DriveSerial.begin(115200);
     DriveSerial.println("@00^CPRI 1 0");  // set serial priority first
@@ -76,3 +94,43 @@ void driveTelem(void) {
         }
     }
 }
+
+// bring the lagged speed up to now
+static void settleEgoMotion(uint32_t now) {
+    int32_t dt = clip((int32_t)(now - last_ego_update), 0L, 1000000L);
+    last_ego_update = now;
+    if(dt == 0) {
+        return;
+    }
+    // v += (commanded - v)*dt/(tau + dt)
+    int32_t tau = ego_params.time_constant*1000L;
+    Fixed<int16_t, 15> k = Fixed<int16_t, 15>::saturated(
+        fixedDivide(dt, tau + dt, 15));
+    ego_velocity += (commanded_velocity - ego_velocity).mul<MillimetersPerSec>(k);
+}
+
+void updateEgoMotion(uint32_t now, int16_t l_drive_value, int16_t r_drive_value) {
+    settleEgoMotion(now);
+    // autodrive adds drive_bias to the left and subtracts it from the
+    // right, so forward is l - r
+    int32_t forward = (int32_t)l_drive_value - r_drive_value;
+    commanded_velocity = MillimetersPerSec::fromInt(
+        forward*ego_params.full_speed/2000);
+}
+
+MillimetersPerSec getEgoVelocity(uint32_t now) {
+    settleEgoMotion(now);
+    return ego_velocity;
+}
+
+void setEgoMotionParameters(int16_t full_speed, int16_t time_constant) {
+    ego_params.full_speed = full_speed;
+    ego_params.time_constant = time_constant;
+    eeprom_write_block(&ego_params, &saved_ego_params,
+                       sizeof(struct EgoMotionParameters));
+}
+
+void restoreEgoMotionParameters(void) {
+    eeprom_read_block(&ego_params, &saved_ego_params,
+                      sizeof(struct EgoMotionParameters));
+}
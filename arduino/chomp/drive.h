@@ -1,5 +1,7 @@
 #ifndef DRIVE_H
 #define DRIVE_H
+#include <stdint.h>
+#include "object.h"
 
 void driveSetup();
 
@@ -10,4 +12,14 @@ void drive(int16_t &l_drive_value, int16_t &r_drive_value);
 
 void driveTelem(void);
 
+// Our forward speed estimated from the wheel commands, so the tracker can
+// take our own motion out of the targets'. The Roboteqs report no wheel
+// speed without encoders, so the estimate follows the commanded speed with
+// a first order lag. Called every loop with the commands in effect, which
+// are the RC values when autodrive is not sending.
+void updateEgoMotion(uint32_t now, int16_t l_drive_value, int16_t r_drive_value);
+MillimetersPerSec getEgoVelocity(uint32_t now);
+void setEgoMotionParameters(int16_t full_speed, int16_t time_constant);
+void restoreEgoMotionParameters(void);
+
 #endif // DRIVE_H
@@ -0,0 +1,69 @@
+#ifndef FAST_PINS_H
+#define FAST_PINS_H
+#include <Arduino.h>
+#include "pins.h"
+
+// Direct port writes for the output pins in pins.h, resolved at compile
+// time. digitalWrite looks the port and bit up in flash tables, checks
+// for a PWM timer and saves SREG on every call, 60 or so cycles. Ports A
+// to G sit in the low I/O space, where a constant bit write is a single
+// sbi/cbi. Ports H to L are only reachable with a load and store, so
+// those writes keep interrupts off around the read-modify-write the way
+// digitalWrite does. A pin without an entry below fails to compile.
+//
+// Writes do not turn off PWM, none of these pins is ever analogWritten.
+template <uint8_t pin> struct FastPin;
+
+#define FAST_PIN(pin, port, bit, extended)                          \
+    template <> struct FastPin<pin> {                               \
+        static inline volatile uint8_t &out(void) { return port; }  \
+        static const uint8_t mask = (1 << bit);                     \
+        static const bool guard = extended;                         \
+    }
+
+// Mega2560 pin to port mapping
+FAST_PIN(THROW_VALVE_DO, PORTG, 5, false);
+FAST_PIN(IGNITER_DO, PORTE, 3, false);
+FAST_PIN(AUX1_2A_DO, PORTH, 3, true);
+FAST_PIN(AUX2_2A_DO, PORTH, 4, true);
+FAST_PIN(SELF_RIGHT_RIGHT_EXTEND_DO, PORTH, 5, true);
+FAST_PIN(SELF_RIGHT_RIGHT_RETRACT_DO, PORTH, 6, true);
+FAST_PIN(ENABLE_VALVE_DO, PORTB, 4, false);
+FAST_PIN(VENT_VALVE_DO, PORTB, 5, false);
+FAST_PIN(PROPANE_DO, PORTF, 6, false);
+FAST_PIN(RETRACT_VALVE_DO, PORTF, 7, false);
+FAST_PIN(VACUUM_VALVE_DO, PORTK, 0, true);
+FAST_PIN(AUX3_2A_DO, PORTK, 1, true);
+FAST_PIN(SELF_RIGHT_LEFT_EXTEND_DO, PORTK, 2, true);
+FAST_PIN(SELF_RIGHT_LEFT_RETRACT_DO, PORTK, 3, true);
+
+#undef FAST_PIN
+
+template <uint8_t pin> static inline void fastPortWrite(uint8_t val) {
+    typedef FastPin<pin> P;
+    if(val == LOW) {
+        P::out() &= ~P::mask;
+    } else {
+        P::out() |= P::mask;
+    }
+}
+
+template <uint8_t pin> static inline void fastDigitalWrite(uint8_t val) {
+    if(FastPin<pin>::guard) {
+        uint8_t oldSREG = SREG;
+        cli();
+        fastPortWrite<pin>(val);
+        SREG = oldSREG;
+    } else {
+        fastPortWrite<pin>(val);
+    }
+}
+
+// safeDigitalWrite's g_enabled gate
+template <uint8_t pin> static inline void safeFastDigitalWrite(uint8_t val) {
+    if(g_enabled) {
+        fastDigitalWrite<pin>(val);
+    }
+}
+
+#endif  // FAST_PINS_H
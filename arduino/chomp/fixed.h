@@ -0,0 +1,202 @@
+#ifndef FIXED_H
+#define FIXED_H
+#include <stdint.h>
+#include "fixed_math.h"
+
+// Header only Q format fixed point. Fixed<Storage, FracBits> holds
+// value*2^FracBits in a Storage integer, so the scaling lives in the type
+// instead of in comments and magic divisors.
+//
+// Format conversions are resolved at compile time into a single shift.
+// Products are formed 16x16->32 or 32x16->48 bits (as two 16x16
+// multiplies) before being rescaled, so they only overflow if the result
+// does not fit. 32x32 products are formed in 32 bits and the caller must
+// bound the operands. Right shifts round toward minus infinity, so a
+// result can differ by 1 LSB from the truncating division it replaces.
+//
+// Plain +, - and the conversions wrap like the underlying integers, the
+// sat* operations and saturated() clamp to the storage range.
+
+template <typename T> struct FixedLimits;
+template <> struct FixedLimits<int8_t> {
+    static int8_t lowest(void) { return -128; }
+    static int8_t highest(void) { return 127; }
+};
+template <> struct FixedLimits<int16_t> {
+    static int16_t lowest(void) { return -32768; }
+    static int16_t highest(void) { return 32767; }
+};
+template <> struct FixedLimits<int32_t> {
+    static int32_t lowest(void) { return -2147483647L - 1; }
+    static int32_t highest(void) { return 2147483647L; }
+};
+
+// v*2^Shift, a left shift for positive Shift and a flooring right shift
+// for negative Shift
+template <int Shift, bool Left = (Shift >= 0)>
+struct FixedShift {
+    template <typename T> static T apply(T v) {
+        return v * (T)(1L << Shift);
+    }
+};
+template <int Shift>
+struct FixedShift<Shift, false> {
+    template <typename T> static T apply(T v) {
+        return v >> -Shift;
+    }
+};
+
+// the wider of two storage types
+template <typename A, typename B, bool = (sizeof(A) >= sizeof(B))>
+struct FixedLarger {
+    typedef A type;
+};
+template <typename A, typename B>
+struct FixedLarger<A, B, false> {
+    typedef B type;
+};
+
+// a*b*2^-Shift without intermediate overflow
+template <typename A, typename B, int Shift> struct FixedProduct;
+template <int Shift> struct FixedProduct<int16_t, int16_t, Shift> {
+    static int32_t apply(int16_t a, int16_t b) {
+        return FixedShift<-Shift>::apply(mul16x16(a, b));
+    }
+};
+template <int Shift> struct FixedProduct<int32_t, int16_t, Shift> {
+    static int32_t apply(int32_t a, int16_t b) {
+        static_assert(Shift >= 0 && Shift <= 16,
+                      "32x16 products rescale by 0 to 16 bits");
+        int16_t hi = a >> 16;
+        uint16_t lo = a & 0xffff;
+        return mul16x16(hi, b) * (1L << (16 - Shift)) +
+               (((int32_t)(uint32_t)lo * b) >> Shift);
+    }
+};
+template <int Shift> struct FixedProduct<int16_t, int32_t, Shift> {
+    static int32_t apply(int16_t a, int32_t b) {
+        return FixedProduct<int32_t, int16_t, Shift>::apply(b, a);
+    }
+};
+template <int Shift> struct FixedProduct<int32_t, int32_t, Shift> {
+    static int32_t apply(int32_t a, int32_t b) {
+        return FixedShift<-Shift>::apply(a * b);
+    }
+};
+
+template <typename Storage, int FracBits>
+class Fixed {
+public:
+    typedef Storage storage_type;
+    static const int frac_bits = FracBits;
+
+    Fixed() : v(0) { }
+
+    static Fixed fromRaw(Storage raw) {
+        Fixed f;
+        f.v = raw;
+        return f;
+    }
+
+    static Fixed fromInt(int32_t i) {
+        return fromRaw(FixedShift<FracBits>::apply(i));
+    }
+
+    // raw value clamped to the storage range
+    static Fixed saturated(int32_t raw) {
+        if(raw < FixedLimits<Storage>::lowest()) {
+            return fromRaw(FixedLimits<Storage>::lowest());
+        }
+        if(raw > FixedLimits<Storage>::highest()) {
+            return fromRaw(FixedLimits<Storage>::highest());
+        }
+        return fromRaw(raw);
+    }
+
+    // rescale from another format
+    template <typename S, int F>
+    static Fixed from(const Fixed<S, F> &other) {
+        typedef typename FixedLarger<Storage, S>::type T;
+        return fromRaw(FixedShift<FracBits - F>::apply((T)other.raw()));
+    }
+
+    Storage raw(void) const { return v; }
+
+    // integer part, rounded toward minus infinity
+    int32_t toInt(void) const {
+        return FixedShift<-FracBits>::apply((int32_t)v);
+    }
+
+    Fixed operator-() const { return fromRaw(-v); }
+    Fixed operator+(const Fixed &o) const { return fromRaw(v + o.v); }
+    Fixed operator-(const Fixed &o) const { return fromRaw(v - o.v); }
+    Fixed &operator+=(const Fixed &o) { v += o.v; return *this; }
+    Fixed &operator-=(const Fixed &o) { v -= o.v; return *this; }
+
+    bool operator<(const Fixed &o) const { return v < o.v; }
+    bool operator>(const Fixed &o) const { return v > o.v; }
+    bool operator<=(const Fixed &o) const { return v <= o.v; }
+    bool operator>=(const Fixed &o) const { return v >= o.v; }
+    bool operator==(const Fixed &o) const { return v == o.v; }
+    bool operator!=(const Fixed &o) const { return v != o.v; }
+
+    Fixed magnitude(void) const { return v < 0 ? fromRaw(-v) : *this; }
+
+    Fixed clip(const Fixed &lo, const Fixed &hi) const {
+        if(v < lo.v) return lo;
+        if(v > hi.v) return hi;
+        return *this;
+    }
+
+    Fixed satAdd(const Fixed &o) const {
+        Storage r = (Storage)((uint32_t)v + (uint32_t)o.v);
+        // overflow when both operands have the sign the result lacks
+        if(((v ^ r) & (o.v ^ r)) < 0) {
+            return fromRaw(v < 0 ? FixedLimits<Storage>::lowest() :
+                                   FixedLimits<Storage>::highest());
+        }
+        return fromRaw(r);
+    }
+
+    Fixed satSub(const Fixed &o) const {
+        Storage r = (Storage)((uint32_t)v - (uint32_t)o.v);
+        // overflow when the operands differ in sign and the result
+        // has the sign of the subtrahend
+        if(((v ^ o.v) & (v ^ r)) < 0) {
+            return fromRaw(v < 0 ? FixedLimits<Storage>::lowest() :
+                                   FixedLimits<Storage>::highest());
+        }
+        return fromRaw(r);
+    }
+
+    // widening product rescaled to the result format R, which wraps if the
+    // result does not fit, see satMul
+    template <typename R, typename S, int F>
+    R mul(const Fixed<S, F> &o) const {
+        return R::fromRaw(
+            FixedProduct<Storage, S, FracBits + F - R::frac_bits>::apply(
+                v, o.raw()));
+    }
+
+    // widening product rescaled to R and clamped to its storage range
+    template <typename R, typename S, int F>
+    R satMul(const Fixed<S, F> &o) const {
+        return R::saturated(
+            FixedProduct<Storage, S, FracBits + F - R::frac_bits>::apply(
+                v, o.raw()));
+    }
+
+    // quotient in the result format R, saturating, see fixedDivide
+    template <typename R, typename S, int F>
+    R div(const Fixed<S, F> &o) const {
+        static_assert(R::frac_bits - FracBits + F >= 0,
+                      "quotient needs a non-negative scale");
+        return R::saturated(
+            fixedDivide(v, o.raw(), R::frac_bits - FracBits + F));
+    }
+
+private:
+    Storage v;
+};
+
+#endif  // FIXED_H
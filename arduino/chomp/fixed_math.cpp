@@ -0,0 +1,242 @@
+#include <avr/pgmspace.h>
+#include "fixed_math.h"
+
+// sin(k*pi/256)*16384 for k = 0..128, one quarter wave
+static const int16_t SIN_TABLE[129] PROGMEM = {
+        0,   201,   402,   603,   804,  1005,  1205,  1406,  1606,  1806,
+     2006,  2205,  2404,  2603,  2801,  2999,  3196,  3393,  3590,  3786,
+     3981,  4176,  4370,  4563,  4756,  4948,  5139,  5330,  5520,  5708,
+     5897,  6084,  6270,  6455,  6639,  6823,  7005,  7186,  7366,  7545,
+     7723,  7900,  8076,  8250,  8423,  8595,  8765,  8935,  9102,  9269,
+     9434,  9598,  9760,  9921, 10080, 10238, 10394, 10549, 10702, 10853,
+    11003, 11151, 11297, 11442, 11585, 11727, 11866, 12004, 12140, 12274,
+    12406, 12537, 12665, 12792, 12916, 13039, 13160, 13279, 13395, 13510,
+    13623, 13733, 13842, 13949, 14053, 14155, 14256, 14354, 14449, 14543,
+    14635, 14724, 14811, 14896, 14978, 15059, 15137, 15213, 15286, 15357,
+    15426, 15493, 15557, 15619, 15679, 15736, 15791, 15843, 15893, 15941,
+    15986, 16029, 16069, 16107, 16143, 16176, 16207, 16235, 16261, 16284,
+    16305, 16324, 16340, 16353, 16364, 16373, 16379, 16383, 16384,
+};
+
+// atan(k/128)*16384 for k = 0..128
+static const int16_t ATAN_TABLE[129] PROGMEM = {
+        0,   128,   256,   384,   512,   640,   767,   895,  1023,  1150,
+     1277,  1405,  1532,  1658,  1785,  1911,  2037,  2163,  2289,  2414,
+     2539,  2664,  2789,  2913,  3037,  3160,  3283,  3406,  3528,  3650,
+     3772,  3893,  4014,  4134,  4254,  4373,  4492,  4610,  4728,  4846,
+     4962,  5079,  5195,  5310,  5425,  5539,  5653,  5766,  5878,  5990,
+     6101,  6212,  6322,  6432,  6541,  6649,  6757,  6864,  6971,  7076,
+     7182,  7286,  7390,  7494,  7596,  7698,  7800,  7901,  8001,  8100,
+     8199,  8297,  8395,  8492,  8588,  8684,  8779,  8873,  8967,  9060,
+     9152,  9244,  9335,  9425,  9515,  9604,  9693,  9781,  9868,  9954,
+    10040, 10126, 10210, 10295, 10378, 10461, 10543, 10625, 10706, 10786,
+    10866, 10945, 11024, 11102, 11179, 11256, 11332, 11408, 11483, 11557,
+    11631, 11705, 11777, 11850, 11921, 11992, 12063, 12133, 12202, 12271,
+    12340, 12407, 12475, 12542, 12608, 12674, 12739, 12804, 12868,
+};
+
+// 2^31/(32768 + k*256) - 32768 for k = 0..128
+static const uint16_t RECIPROCAL_TABLE[129] PROGMEM = {
+    32768, 32260, 31760, 31267, 30782, 30304, 29834, 29370, 28913, 28463,
+    28019, 27582, 27151, 26726, 26307, 25894, 25486, 25084, 24688, 24297,
+    23912, 23531, 23156, 22786, 22420, 22060, 21703, 21352, 21005, 20663,
+    20324, 19991, 19661, 19335, 19014, 18696, 18382, 18072, 17766, 17463,
+    17164, 16869, 16577, 16288, 16003, 15721, 15442, 15167, 14895, 14625,
+    14359, 14096, 13835, 13578, 13323, 13071, 12822, 12576, 12332, 12091,
+    11852, 11616, 11383, 11151, 10923, 10696, 10472, 10251, 10031,  9814,
+     9599,  9386,  9175,  8966,  8760,  8555,  8353,  8152,  7953,  7757,
+     7562,  7369,  7178,  6988,  6801,  6615,  6431,  6249,  6068,  5889,
+     5712,  5536,  5362,  5190,  5019,  4849,  4681,  4515,  4350,  4186,
+     4024,  3863,  3704,  3546,  3390,  3235,  3081,  2928,  2777,  2627,
+     2478,  2331,  2185,  2040,  1896,  1753,  1612,  1471,  1332,  1194,
+     1057,   921,   786,   653,   520,   389,   258,   129,     0,
+};
+
+// sqrt((64 + k)*2^24) - 32768 for k = 0..192
+static const uint16_t SQRT_TABLE[193] PROGMEM = {
+        0,   255,   508,   759,  1008,  1256,  1502,  1746,  1988,  2228,
+     2467,  2704,  2940,  3174,  3407,  3638,  3868,  4096,  4323,  4548,
+     4772,  4995,  5217,  5437,  5656,  5874,  6090,  6305,  6519,  6732,
+     6944,  7155,  7364,  7573,  7780,  7987,  8192,  8396,  8600,  8802,
+     9003,  9204,  9403,  9601,  9799,  9995, 10191, 10386, 10580, 10773,
+    10965, 11157, 11347, 11537, 11726, 11914, 12101, 12288, 12474, 12659,
+    12843, 13027, 13209, 13392, 13573, 13754, 13934, 14113, 14291, 14469,
+    14647, 14823, 14999, 15174, 15349, 15523, 15697, 15869, 16041, 16213,
+    16384, 16554, 16724, 16893, 17062, 17230, 17398, 17564, 17731, 17897,
+    18062, 18227, 18391, 18555, 18718, 18881, 19043, 19204, 19366, 19526,
+    19686, 19846, 20005, 20164, 20322, 20480, 20637, 20794, 20951, 21106,
+    21262, 21417, 21572, 21726, 21879, 22033, 22186, 22338, 22490, 22642,
+    22793, 22944, 23094, 23244, 23394, 23543, 23691, 23840, 23988, 24135,
+    24283, 24430, 24576, 24722, 24868, 25013, 25158, 25303, 25447, 25591,
+    25735, 25878, 26021, 26163, 26305, 26447, 26589, 26730, 26871, 27011,
+    27151, 27291, 27431, 27570, 27709, 27847, 27985, 28123, 28261, 28398,
+    28535, 28672, 28808, 28944, 29080, 29216, 29351, 29486, 29620, 29755,
+    29889, 30022, 30156, 30289, 30422, 30555, 30687, 30819, 30951, 31082,
+    31214, 31345, 31475, 31606, 31736, 31866, 31995, 32125, 32254, 32383,
+    32511, 32640, 32768,
+};
+
+// linear interpolation between table[i] and table[i+1], frac has
+// frac_bits bits
+static inline int16_t interpolate(const int16_t *table, uint8_t i,
+                                  uint8_t frac, uint8_t frac_bits) {
+    int16_t a = pgm_read_word(table + i);
+    int16_t b = pgm_read_word(table + i + 1);
+    return a + (mul16x16(b - a, frac) >> frac_bits);
+}
+
+static inline uint16_t interpolate(const uint16_t *table, uint8_t i,
+                                   uint8_t frac, uint8_t frac_bits) {
+    uint16_t a = pgm_read_word(table + i);
+    uint16_t b = pgm_read_word(table + i + 1);
+    return a + (mul16x16((int16_t)(b - a), frac) >> frac_bits);
+}
+
+// sine of a binary angle, 65536 per revolution
+static int16_t sinBinary(uint16_t b) {
+    uint16_t x = b & 0x3fff;
+    if(b & 0x4000) {
+        x = 0x4000 - x;
+    }
+    int16_t s;
+    if(x >= 0x4000) {
+        s = FIXED_ONE_Q14;
+    } else {
+        s = interpolate(SIN_TABLE, x >> 7, x & 0x7f, 7);
+    }
+    return (b & 0x8000) ? -s : s;
+}
+
+// radians*2048 to binary angle, 65536/(2*pi*2048) = 5 + 6092/65536
+static inline uint16_t toBinary(int16_t angle) {
+    return (uint16_t)angle * 5 +
+           (uint16_t)((mul16x16(angle, 6092) + 0x8000) >> 16);
+}
+
+int16_t fixedSin(int16_t angle) {
+    return sinBinary(toBinary(angle));
+}
+
+int16_t fixedCos(int16_t angle) {
+    return sinBinary(toBinary(angle) + 0x4000);
+}
+
+uint16_t fixedReciprocal(uint16_t d) {
+    if(d < 0x8000) {
+        return 0xffff;
+    }
+    uint16_t x = d - 0x8000;
+    uint32_t r = 0x8000UL + interpolate(RECIPROCAL_TABLE, x >> 8, x & 0xff, 8);
+    return r > 0xffff ? 0xffff : r;
+}
+
+int16_t fixedAtan2(int32_t y, int32_t x) {
+    uint32_t ax = x < 0 ? -(uint32_t)x : x;
+    uint32_t ay = y < 0 ? -(uint32_t)y : y;
+    bool swap = ay > ax;
+    uint32_t mx = swap ? ay : ax;
+    uint32_t mn = swap ? ax : ay;
+    if(mx == 0) {
+        return 0;
+    }
+    // normalize so mx is in [2^15, 2^16)
+    while(mx >= 0x10000UL) {
+        mx >>= 1;
+        mn >>= 1;
+    }
+    while(mx < 0x8000UL) {
+        mx <<= 1;
+        mn <<= 1;
+    }
+    // t = mn/mx in Q15
+    uint16_t t = ((uint32_t)(uint16_t)mn * fixedReciprocal(mx)) >> 16;
+    // atan(t) in radians*16384
+    int32_t a;
+    if(t >= 0x8000) {
+        a = pgm_read_word(ATAN_TABLE + 128);
+    } else {
+        a = interpolate(ATAN_TABLE, t >> 8, t & 0xff, 8);
+    }
+    // pi/2 and pi in radians*16384
+    if(swap) a = 25736L - a;
+    if(x < 0) a = 51472L - a;
+    if(y < 0) a = -a;
+    return (a + 4) >> 3;
+}
+
+uint16_t fixedSqrt(uint32_t n) {
+    if(n == 0) {
+        return 0;
+    }
+    // normalize to [2^30, 2^32)
+    uint32_t m = n;
+    uint8_t shift = 0;
+    while(m < 0x40000000UL) {
+        m <<= 2;
+        shift++;
+    }
+    uint8_t i = (m >> 24) - 64;
+    uint32_t r = 0x8000UL + interpolate(SQRT_TABLE, i, (m >> 16) & 0xff, 8);
+    r >>= shift;
+    // the estimate is within a couple, correct it to floor(sqrt(n))
+    if(r > 0xffff) {
+        r = 0xffff;
+    }
+    while(r * r > n) {
+        r--;
+    }
+    while(r < 0xffff && (r + 1) * (r + 1) <= n) {
+        r++;
+    }
+    return r;
+}
+
+static const int32_t FIXED_MAX = 0x7fffffffL;
+static const int32_t FIXED_MIN = -0x7fffffffL - 1;
+
+int32_t fixedDivide(int32_t num, int32_t den, uint8_t frac_bits) {
+    bool negative = (num < 0) != (den < 0);
+    uint32_t un = num < 0 ? -(uint32_t)num : num;
+    uint32_t ud = den < 0 ? -(uint32_t)den : den;
+    if(ud == 0) {
+        return negative ? FIXED_MIN : FIXED_MAX;
+    }
+    if(un == 0) {
+        return 0;
+    }
+    // normalize both into [2^15, 2^16), tracking the power of two
+    int8_t shift = frac_bits - 31;
+    while(ud >= 0x10000UL) {
+        ud >>= 1;
+        shift--;
+    }
+    while(ud < 0x8000UL) {
+        ud <<= 1;
+        shift++;
+    }
+    while(un >= 0x10000UL) {
+        un >>= 1;
+        shift++;
+    }
+    while(un < 0x8000UL) {
+        un <<= 1;
+        shift--;
+    }
+    // un*2^31/ud in [2^30, 2^32)
+    uint32_t q = un * fixedReciprocal(ud);
+    if(shift > 0) {
+        if(shift > 31 || q > (0x7fffffffUL >> shift)) {
+            return negative ? FIXED_MIN : FIXED_MAX;
+        }
+        q <<= shift;
+    } else if(shift < 0) {
+        if(shift < -31) {
+            return 0;
+        }
+        q = (q + (1UL << (-shift - 1))) >> -shift;
+    }
+    if(q > 0x7fffffffUL) {
+        q = 0x7fffffffUL;
+    }
+    return negative ? -(int32_t)q : (int32_t)q;
+}
@@ -0,0 +1,54 @@
+#ifndef FIXED_MATH_H
+#define FIXED_MATH_H
+#include <stdint.h>
+
+// Fixed point math kernels for the targeting code. Tables live in flash
+// and the kernels only use 16x16->32 multiplies, which the AVR does in
+// hardware, plus shifts.
+//
+// Conventions:
+//   angles are radians scaled by 2048 (pi = 6434)
+//   sine, cosine and other unit quantities are scaled by 16384 (Q14)
+//
+// Error bounds, checked against float references in
+// testcode/test_fixed_math.cpp:
+//   fixedSin, fixedCos   within 2 of round(16384*sin(a)) over all inputs
+//   fixedAtan2           within 1 of round(2048*atan2(y, x))
+//   fixedSqrt            exactly floor(sqrt(n))
+//   fixedReciprocal      within 1 of round(2^31/d)
+//   fixedDivide          relative error below 2^-13
+
+#define FIXED_PI 6434L
+#define FIXED_ONE_Q14 16384
+
+// widening 16x16->32 multiply
+static inline int32_t mul16x16(int16_t a, int16_t b) {
+    return (int32_t)a * b;
+}
+
+// a*b/16384 where b is Q14, a is 32 bit. Split a so only 16x16
+// multiplies are needed.
+static inline int32_t mulQ14(int32_t a, int16_t b) {
+    int16_t hi = a >> 16;
+    uint16_t lo = a & 0xffff;
+    return (mul16x16(hi, b) << 2) +
+           (((int32_t)(uint32_t)lo * b) >> 14);
+}
+
+// sine and cosine of an angle in radians*2048, result in Q14
+int16_t fixedSin(int16_t angle);
+int16_t fixedCos(int16_t angle);
+
+// angle of (x, y) in radians*2048, -pi to pi
+int16_t fixedAtan2(int32_t y, int32_t x);
+
+// floor(sqrt(n))
+uint16_t fixedSqrt(uint32_t n);
+
+// round(2^31/d) for d in [32768, 65535], saturates at 65535
+uint16_t fixedReciprocal(uint16_t d);
+
+// num/den scaled by 2^frac_bits, saturating, using the reciprocal table
+int32_t fixedDivide(int32_t num, int32_t den, uint8_t frac_bits);
+
+#endif  // FIXED_MATH_H
@@ -0,0 +1,92 @@
+#include <Arduino.h>
+#include "gyro_history.h"
+#include "utils.h"
+
+struct GyroSample {
+    uint32_t time;
+    int16_t omega_z;
+};
+
+static struct GyroSample history[GYRO_HISTORY_LENGTH];
+static uint8_t newest = 0;
+static uint8_t count = 0;
+
+void recordGyro(uint32_t time, int16_t omega_z) {
+    newest = (newest + 1) % GYRO_HISTORY_LENGTH;
+    history[newest].time = time;
+    history[newest].omega_z = omega_z;
+    if(count < GYRO_HISTORY_LENGTH) {
+        count++;
+    }
+}
+
+bool lastGyroTime(uint32_t *time) {
+    if(count == 0) {
+        return false;
+    }
+    *time = history[newest].time;
+    return true;
+}
+
+static const struct GyroSample &sample(uint8_t age) {
+    return history[(newest + GYRO_HISTORY_LENGTH - age) % GYRO_HISTORY_LENGTH];
+}
+
+// gyro rate at time t, interpolated between the samples around it
+static int16_t rateAt(uint32_t t) {
+    uint8_t age = 0;
+    // first sample at or before t
+    while(age + 1 < count && (int32_t)(sample(age).time - t) > 0) {
+        age++;
+    }
+    const struct GyroSample &before = sample(age);
+    if(age == 0 || (int32_t)(t - before.time) <= 0) {
+        return before.omega_z;
+    }
+    const struct GyroSample &after = sample(age - 1);
+    // in 64us steps to keep the product in 32 bits
+    int32_t span = (after.time - before.time) >> 6;
+    int32_t into = (t - before.time) >> 6;
+    if(span <= 0) {
+        return before.omega_z;
+    }
+    int32_t delta = (int32_t)after.omega_z - before.omega_z;
+    return before.omega_z + delta*into/span;
+}
+
+// rotation in dt microseconds going from rate a to rate b, in units of
+// 1024 count microseconds, segments are clipped at half a second
+static int32_t segment(int16_t a, int16_t b, uint32_t dt) {
+    int32_t mean = ((int32_t)a + b)/2;
+    return (mean*clip((int32_t)(dt >> 4), 0L, 32767L)) >> 6;
+}
+
+int32_t gyroRotation(uint32_t t0, uint32_t t1) {
+    if(count == 0) {
+        return 0;
+    }
+    if((int32_t)(t1 - t0) < 0) {
+        return -gyroRotation(t1, t0);
+    }
+    // newest first, so a query over the last few ms only visits a few
+    // samples
+    int32_t rotation = 0;
+    uint32_t to = t1;
+    int16_t rate = rateAt(t1);
+    for(uint8_t age = 0; age < count; age++) {
+        const struct GyroSample &s = sample(age);
+        if((int32_t)(s.time - t1) >= 0) {
+            continue;
+        }
+        if((int32_t)(s.time - t0) <= 0) {
+            break;
+        }
+        rotation += segment(s.omega_z, rate, to - s.time);
+        to = s.time;
+        rate = s.omega_z;
+    }
+    rotation += segment(rateAt(t0), rate, to - t0);
+    // (2000deg/sec)/(32768 full scale)*pi/180*2048 = 35/16 per count, so
+    // 1024 count microseconds are 1024*35/16/1e6 = 28/12500 radians*2048
+    return rotation*28/12500;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <stdint.h>
+
+// Timestamped gyro Z samples, so rotation between any two times can be
+// integrated from every reading instead of estimated from the last two.
+// Samples are raw IMU counts at the 2000 deg/s full scale.
+#define GYRO_HISTORY_LENGTH 32
+
+void recordGyro(uint32_t time, int16_t omega_z);
+
+// Rotation from t0 to t1 in radians*2048, negative for clockwise. The gyro
+// rate is linear between samples and held past the oldest and newest.
+int32_t gyroRotation(uint32_t t0, uint32_t t1);
+
+// most recent sample time, false before the first sample
+bool lastGyroTime(uint32_t *time);
@@ -0,0 +1,83 @@
+#include <Arduino.h>
+#include "hammer_velocity.h"
+#include "fixed_math.h"
+
+#define HAMMER_VELOCITY_SAMPLES 16
+// fewest samples, and the shortest span of them, a fit is trusted from
+#define MIN_FIT_SAMPLES 4
+#define MIN_FIT_SPAN 4000UL
+// the main loop reads the angle every 5ms, allow for slow loops
+#define MAX_SAMPLE_AGE 50000UL
+// fit times are in 64us units, 40ms is 625 of them
+#define TIME_SHIFT 6
+#define UNITS_PER_SEC (1000000L >> TIME_SHIFT)
+
+static uint32_t times[HAMMER_VELOCITY_SAMPLES];
+static uint16_t angles[HAMMER_VELOCITY_SAMPLES];
+static uint8_t newest = 0;
+static uint8_t num_samples = 0;
+static bool fit_valid = false;
+static int16_t velocity = 0;
+
+// Slope of the centred fit, sum(dt*da)/sum(dt*dt). With at most 16
+// samples of 625 units and 360 degrees the sums stay far inside 32 bits.
+static void refit(void) {
+    uint32_t now = times[newest];
+    uint8_t n = 0;
+    int32_t sum_t = 0, sum_a = 0;
+    uint32_t span = 0;
+    for(uint8_t i = 0; i < num_samples; i++) {
+        uint8_t s = (newest + HAMMER_VELOCITY_SAMPLES - i) % HAMMER_VELOCITY_SAMPLES;
+        uint32_t age = now - times[s];
+        if(age > HAMMER_VELOCITY_WINDOW) {
+            break;
+        }
+        span = age;
+        sum_t -= age >> TIME_SHIFT;
+        sum_a += angles[s];
+        n++;
+    }
+    fit_valid = n >= MIN_FIT_SAMPLES && span >= MIN_FIT_SPAN;
+    if(!fit_valid) {
+        return;
+    }
+    int16_t mean_t = sum_t / n;
+    int16_t mean_a = sum_a / n;
+    int32_t sum_tt = 0, sum_ta = 0;
+    for(uint8_t i = 0; i < n; i++) {
+        uint8_t s = (newest + HAMMER_VELOCITY_SAMPLES - i) % HAMMER_VELOCITY_SAMPLES;
+        int16_t dt = -(int16_t)((now - times[s]) >> TIME_SHIFT) - mean_t;
+        int16_t da = (int16_t)angles[s] - mean_a;
+        sum_tt += mul16x16(dt, dt);
+        sum_ta += mul16x16(dt, da);
+    }
+    // degrees per unit in Q16, a 6000 deg/s swing is 0.38 of a degree
+    int32_t slope = fixedDivide(sum_ta, sum_tt, 16);
+    velocity = (slope * UNITS_PER_SEC) >> 16;
+}
+
+void hammerVelocitySample(uint32_t time, uint16_t angle) {
+    if(num_samples > 0 && time == times[newest]) {
+        return;
+    }
+    newest = (newest + 1) % HAMMER_VELOCITY_SAMPLES;
+    times[newest] = time;
+    angles[newest] = angle;
+    if(num_samples < HAMMER_VELOCITY_SAMPLES) {
+        num_samples++;
+    }
+    refit();
+}
+
+void hammerVelocityReset(void) {
+    num_samples = 0;
+    fit_valid = false;
+}
+
+bool hammerVelocity(int16_t *degrees_per_sec) {
+    if(!fit_valid || micros() - times[newest] > MAX_SAMPLE_AGE) {
+        return false;
+    }
+    *degrees_per_sec = velocity;
+    return true;
+}
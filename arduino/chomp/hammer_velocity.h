@@ -0,0 +1,16 @@
+#pragma once
+#include <stdint.h>
+
+// Hammer angular velocity kept up to date from the angle samples the rest
+// of the code already takes, so reading it costs nothing and never waits
+// on the ADC. Each sample refits a least squares line through the samples
+// of the last HAMMER_VELOCITY_WINDOW microseconds.
+#define HAMMER_VELOCITY_WINDOW 40000UL
+
+// a sample taken at time, repeats of the newest time are ignored
+void hammerVelocitySample(uint32_t time, uint16_t angle);
+// a failed angle read, the fit starts over
+void hammerVelocityReset(void);
+// degrees per second, positive in the swing direction. False until the
+// window holds enough samples or when the newest one is stale.
+bool hammerVelocity(int16_t *degrees_per_sec);
@@ -1,6 +1,7 @@
 #include <Arduino.h>
 #include "hold_down.h"
 #include "pins.h"
+#include "fast_pins.h"
 #include "telem.h"
 #include "sensors.h"
 
@@ -27,13 +28,13 @@ void holdDownSafe()
 {
     tlm_triggered = 0;
     sample_index = 0;
-    digitalWrite(VACUUM_VALVE_DO, LOW);
+    fastDigitalWrite<VACUUM_VALVE_DO>(LOW);
     pinMode(VACUUM_VALVE_DO, OUTPUT);
 }
 
 static void holdDownEnable(bool enable)
 {
-    digitalWrite(VACUUM_VALVE_DO, enable);
+    fastDigitalWrite<VACUUM_VALVE_DO>(enable);
 }
 
 void endHoldDownSample()
@@ -2,6 +2,7 @@
 #include "telem_message_stream.h"
 #include "MPU6050.h"
 #include "imu.h"
+#include "gyro_history.h"
 
 static void saveIMUParameters(void);
 static void restoreIMUParameters(void);
@@ -10,6 +11,7 @@ MPU6050 IMU;
 static int16_t acceleration[3], angular_rate[3];
 static int16_t temperature;
 uint32_t last_imu_process;
+static uint32_t last_gyro_read;
 bool stationary, imu_read_valid;
 static enum Orientation best_orientation;
 static int32_t sum_angular_rate;
@@ -26,6 +28,7 @@ struct IMUParameters {
     int16_t max_total_norm;
     int16_t x_threshold;
     int16_t z_threshold;
+    uint32_t gyro_period;
 } __attribute__((packed));
 
 static struct IMUParameters params;
@@ -39,7 +42,8 @@ static struct IMUParameters EEMEM saved_params = {
     .max_valid_cross = 2458,
     .max_total_norm = 3584,
     .x_threshold = 1229,
-    .z_threshold = 2028
+    .z_threshold = 2028,
+    .gyro_period=10000
 };
 
 
@@ -55,6 +59,7 @@ void initializeIMU(void) {
     IMU.setFullScaleAccelRange(MPU6050_ACCEL_FS_16);
     IMU.setDLPFMode(MPU6050_DLPF_BW_20);
     last_imu_process = micros();
+    last_gyro_read = last_imu_process;
 }
 
 
@@ -75,6 +80,8 @@ static bool  maybeReadIMU(void)
             return false;
         }
         imu_read_valid = true;
+        last_gyro_read = now;
+        recordGyro(now, angular_rate[2]);
         temperature = IMU.getTemperature();
         sum_angular_rate = (abs(angular_rate[0]) +
                             abs(angular_rate[1]) +
@@ -99,8 +106,27 @@ static bool  maybeReadIMU(void)
 }
 
 
+// gyro Z alone between full reads, for the rotation history
+static void maybeReadGyro(void)
+{
+    uint32_t now = micros();
+    if(now-last_gyro_read > params.gyro_period) {
+        last_gyro_read = now;
+        int16_t omega_z;
+        if(IMU.getRotationZ(&omega_z) != 0) {
+            imu_read_valid = false;
+            return;
+        }
+        imu_read_valid = true;
+        angular_rate[2] = omega_z;
+        recordGyro(now, omega_z);
+    }
+}
+
+
 // State machine to distribute compute over several cycles
 void processIMU(void) {
+    maybeReadGyro();
     if(maybeReadIMU()) {
         // Compute cross product with Zhat
         // a = measured
@@ -156,7 +182,8 @@ bool getOmegaZ(int16_t *omega_z) {
 void setIMUParameters(
     int8_t dlpf, int32_t imu_period, int32_t stationary_threshold,
     int16_t upright_cross, int16_t min_valid_cross, int16_t max_valid_cross,
-    int16_t max_total_norm, int16_t x_threshold, int16_t z_threshold)
+    int16_t max_total_norm, int16_t x_threshold, int16_t z_threshold,
+    uint32_t gyro_period)
 {
     IMU.setDLPFMode(dlpf);
     params.dlpf_mode = dlpf;
@@ -168,6 +195,7 @@ void setIMUParameters(
     params.max_total_norm = max_total_norm;
     params.x_threshold = x_threshold;
     params.z_threshold = z_threshold;
+    params.gyro_period = gyro_period;
     saveIMUParameters();
 }
 
@@ -57,17 +57,27 @@ static const uint8_t CRC_LO[] =
 struct LeddarParameters {
     int16_t min_detection_distance;
     int16_t max_detection_distance;
+    int16_t field_of_view;      // degrees*10 across all segments
+    uint8_t segments;           // segments in use
+    int16_t mount_offset;       // degrees*10, positive to the left
+    uint8_t upside_down;        // segment order is reversed
 } __attribute__((packed));
 
 static struct LeddarParameters EEMEM saved_params = {
     .min_detection_distance = 20,
     .max_detection_distance = 600,
+    .field_of_view = 990,
+    .segments = LEDDAR_SEGMENTS,
+    .mount_offset = 0,
+    .upside_down = 1,
 };
 
 static struct LeddarParameters params;
+static struct SegmentGeometry geometry;
 
 static void saveLeddarParmeters(void);
 static void restoreLeddarParameters(void);
+static void computeSegmentGeometry(void);
 
 static Detection RawDetections[MAX_DETECTIONS];
 static uint8_t good_detections;
@@ -75,6 +85,7 @@ static Detection MinimumDetections[LEDDAR_SEGMENTS];
 
 void leddarWrapperInit(){
   restoreLeddarParameters();
+  computeSegmentGeometry();
   for(size_t i=0; i<LEDDAR_SEGMENTS; i++) {
     MinimumDetections[i].Segment = i;
   }
@@ -160,8 +171,14 @@ uint8_t parseDetections(){
       uint16_t distance = current[0];
       uint16_t amplitude = current[1];
 
-      // flip the segment ID since we're upside down
-      uint8_t segment = (LEDDAR_SEGMENTS-1) - (receivedData[offset+4]/LEDDAR_SEGMENTS);
+      uint8_t segment = receivedData[offset+4]/16;
+      if (segment >= geometry.segments) {
+        continue;
+      }
+      // flip the segment ID if we're upside down
+      if (params.upside_down) {
+        segment = (geometry.segments-1) - segment;
+      }
       RawDetections[good_detections].Distance = distance;
       RawDetections[good_detections].Amplitude = amplitude;
       RawDetections[good_detections].Segment = segment;
@@ -195,11 +212,46 @@ size_t getMinimumDetections(const Detection (**detections)[LEDDAR_SEGMENTS]) {
  return LEDDAR_SEGMENTS;
 }
 
+const SegmentGeometry &getSegmentGeometry(void) {
+  return geometry;
+}
+
+// Segment i is centered at
+//   mount_offset + ((segments-1)/2 - i)*field_of_view/segments
+// so segment 0 is the leftmost segment after any flip.
+static void computeSegmentGeometry(void) {
+  uint8_t segments = constrain(params.segments, 2, LEDDAR_SEGMENTS);
+  float width = params.field_of_view * (float)(M_PI/1800.0) / segments;
+  float offset = params.mount_offset * (float)(M_PI/1800.0);
+  geometry.segments = segments;
+  geometry.width = lround(width * 2048);
+  for (uint8_t i = 0; i < segments; i++) {
+    float a = offset + ((segments - 1) * 0.5f - i) * width;
+    geometry.angle[i] = lround(a * 2048);
+    geometry.cosine[i] = lround(cos(a) * 16384);
+    geometry.sine[i] = lround(sin(a) * 16384);
+  }
+  for (uint8_t i = segments; i < LEDDAR_SEGMENTS; i++) {
+    geometry.angle[i] = geometry.angle[segments-1];
+    geometry.cosine[i] = geometry.cosine[segments-1];
+    geometry.sine[i] = geometry.sine[segments-1];
+  }
+}
+
 void setLeddarParameters(int16_t min_detection_distance,
-                         int16_t max_detection_distance)
+                         int16_t max_detection_distance,
+                         int16_t field_of_view,
+                         uint8_t segments,
+                         int16_t mount_offset,
+                         bool upside_down)
 {
     params.min_detection_distance = min_detection_distance;
     params.max_detection_distance = max_detection_distance;
+    params.field_of_view = field_of_view;
+    params.segments = segments;
+    params.mount_offset = mount_offset;
+    params.upside_down = upside_down;
+    computeSegmentGeometry();
     saveLeddarParmeters();
 }
 
@@ -5,6 +5,8 @@
 #include <stddef.h>
 
 #define LEDDAR_FREQ 50
+// maximum number of segments, sizes the detection buffers. The number of
+// segments actually in use is a runtime parameter.
 #define LEDDAR_SEGMENTS 16
 
 // Represents a measurement
@@ -21,6 +23,19 @@ struct Detection
   void reset(void) { Distance = reset_distance; Amplitude = 0; };
 };
 
+// Per segment lookup tables computed once from the configured sensor
+// geometry so the targeting code only has to do lookups and multiplies.
+// angles are radians scaled by 2048, positive to the left.
+// sine and cosine are scaled by 16384.
+struct SegmentGeometry
+{
+  uint8_t segments;     // number of segments in use
+  int16_t width;        // angular width of one segment
+  int16_t angle[LEDDAR_SEGMENTS];
+  int16_t cosine[LEDDAR_SEGMENTS];
+  int16_t sine[LEDDAR_SEGMENTS];
+};
+
 void leddarWrapperInit();
 
 void requestDetections();
@@ -31,7 +46,13 @@ void calculateMinimumDetections(size_t good_detections);
 size_t getRawDetections(const Detection **detections);
 size_t getMinimumDetections(const Detection (**detections)[LEDDAR_SEGMENTS]);
 
+const SegmentGeometry &getSegmentGeometry(void);
+
 void setLeddarParameters(int16_t min_object_distance,
-                         int16_t max_object_distance);
+                         int16_t max_object_distance,
+                         int16_t field_of_view,
+                         uint8_t segments,
+                         int16_t mount_offset,
+                         bool upside_down);
  
 #endif  // LEDDAR_IO_H
@@ -1,22 +1,38 @@
 #pragma once
 #include <stdint.h>
+#include "fixed.h"
+
+// formats used through the targeting pipeline
+typedef Fixed<int32_t, 4> Millimeters;        // positions, mm*16
+typedef Fixed<int32_t, 4> MillimetersPerSec;  // velocities, mm/s*16
+typedef Fixed<int16_t, 11> Radians;           // angles, radians*2048
+typedef Fixed<int32_t, 11> RadiansPerSec;     // rates, radians/s*2048
+typedef Fixed<int16_t, 14> UnitQ14;           // sine, cosine, gains < 2
+
 struct Object
 {
     uint16_t SumDistance;
     int32_t SumIntensity;
     int32_t SumAngleIntensity;
     int8_t LeftEdge, RightEdge;
+    int8_t VisibleSegments;  // segments summed, fewer than the edges span
+                             // if a nearer object hides part of this one
+    bool Partial;            // an edge or some segments are hidden
     uint32_t Time;
 
+    // features, computed once per object by computeFeatures()
+    int16_t Size;      // circumferential size in mm
+    int16_t Radius;    // average radius in mm
+    Radians Angle;
+    Millimeters X, Y;
+
     // Default constructor
     Object() : SumDistance(0),
                LeftEdge(0), RightEdge(0),
-               Time(0) { }
-    int16_t size(void) const;
-    int16_t angle(void) const;
-    int16_t xcoord(void) const;
-    int16_t ycoord(void) const;
-    int16_t radius(void) const;
-    inline int32_t distanceSq(const Object &other) const;
+               VisibleSegments(0), Partial(false),
+               Time(0),
+               Size(0), Radius(0) { }
+    void computeFeatures(void);
+    int32_t distanceSq(const Object &other) const;
 };
 
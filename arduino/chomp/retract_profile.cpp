@@ -0,0 +1,95 @@
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include "retract_profile.h"
+#include "hammer_velocity.h"
+#include "fixed_math.h"
+#include "telem.h"
+#include "utils.h"
+
+static void saveRetractParameters(void);
+
+struct RetractParams {
+    uint16_t full_speed;   // deg/s at command 1000
+    uint16_t decel;        // deg/s^2
+    uint16_t min_command;
+    uint8_t gain;          // command per deg/s of speed error, 16ths
+    uint16_t period;       // us
+} __attribute__((packed));
+
+static struct RetractParams EEMEM saved_params = {
+    .full_speed = 400,
+    .decel = 4000,
+    .min_command = 300,
+    .gain = 16,
+    .period = 5000,
+};
+
+static struct RetractParams params;
+
+#define MAX_RETRACT_COMMAND 1000
+
+static struct {
+    uint32_t start;
+    uint16_t start_angle;
+    uint8_t source;
+    int16_t peak_speed;
+} current;
+
+int16_t retractCommand(uint16_t angle, uint16_t stop_angle) {
+    if(angle <= stop_angle) {
+        return 0;
+    }
+    uint32_t remaining = angle - stop_angle;
+    int16_t target = fixedSqrt(2UL * params.decel * remaining);
+    if(target > (int16_t)params.full_speed) {
+        target = params.full_speed;
+    }
+    int32_t command = (int32_t)target * MAX_RETRACT_COMMAND /
+                      (params.full_speed ? params.full_speed : 1);
+    int16_t velocity;
+    if(hammerVelocity(&velocity)) {
+        // retracting runs the angle down
+        int16_t speed = -velocity;
+        if(speed > current.peak_speed) {
+            current.peak_speed = speed;
+        }
+        command += (int32_t)(target - speed) * params.gain / 16;
+    }
+    return clip(command, (int32_t)params.min_command,
+                (int32_t)MAX_RETRACT_COMMAND);
+}
+
+uint16_t getRetractPeriod(void) {
+    return params.period;
+}
+
+void retractStarted(enum RetractSource source, uint16_t angle) {
+    current.start = micros();
+    current.start_angle = angle;
+    current.source = source;
+    current.peak_speed = 0;
+}
+
+void retractFinished(uint16_t angle, bool complete) {
+    sendRetractTelemetry(current.source, complete, micros() - current.start,
+                         current.start_angle, angle, current.peak_speed);
+}
+
+void setRetractParameters(uint16_t full_speed, uint16_t decel,
+                          uint16_t min_command, uint8_t gain,
+                          uint16_t period) {
+    params.full_speed = full_speed;
+    params.decel = decel;
+    params.min_command = min_command;
+    params.gain = gain;
+    params.period = period;
+    saveRetractParameters();
+}
+
+static void saveRetractParameters(void) {
+    eeprom_write_block(&params, &saved_params, sizeof(struct RetractParams));
+}
+
+void restoreRetractParameters(void) {
+    eeprom_read_block(&params, &saved_params, sizeof(struct RetractParams));
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <stdint.h>
+
+enum RetractSource {
+    RETRACT_MANUAL = 0,
+    RETRACT_AUTO,
+    RETRACT_SELF_RIGHT
+};
+
+// Speed profile for the electric hammer moves toward the back stop. The
+// target speed is full_speed until the braking distance at decel reaches
+// the remaining angle, then falls as sqrt(2*decel*remaining). The Roboteq
+// command is the target's share of full_speed, the speed at command 1000,
+// plus gain/16 per deg/s the measured speed is short of it, never below
+// min_command so the hammer always arrives.
+int16_t retractCommand(uint16_t angle, uint16_t stop_angle);
+// microseconds between commands to the Roboteq while moving
+uint16_t getRetractPeriod(void);
+
+// bracket a move so its duration goes out as telemetry
+void retractStarted(enum RetractSource source, uint16_t angle);
+void retractFinished(uint16_t angle, bool complete);
+
+void setRetractParameters(uint16_t full_speed, uint16_t decel,
+                          uint16_t min_command, uint8_t gain,
+                          uint16_t period);
+void restoreRetractParameters(void);
@@ -1,14 +1,14 @@
 #include "Arduino.h"
 #include "pins.h"
 #include "weapons.h" // weaponsEnabled
-#include "utils.h"   // safeDigitalWrite
+#include "fast_pins.h"   // safeFastDigitalWrite
 #include "imu.h"
 #include "sensors.h"
 #include "telem.h"
+#include "hammer_velocity.h"
+#include "retract_profile.h"
 
 
-extern HardwareSerial& DriveSerial;
-
 static void saveSelfRightParameters();
 
 enum SelfRightOrientation {
@@ -20,56 +20,56 @@ enum SelfRightOrientation {
 
 void selfRightExtendLeft(){
     if (weaponsEnabled()){
-        safeDigitalWrite(SELF_RIGHT_LEFT_EXTEND_DO, HIGH);
+        safeFastDigitalWrite<SELF_RIGHT_LEFT_EXTEND_DO>(HIGH);
     }
 }
 
 void selfRightRetractLeft(){
     if(weaponsEnabled()){
-        safeDigitalWrite(SELF_RIGHT_LEFT_RETRACT_DO, HIGH);
+        safeFastDigitalWrite<SELF_RIGHT_LEFT_RETRACT_DO>(HIGH);
     }
 }
 
 
 void selfRightExtendRight(){
     if (weaponsEnabled()){
-        safeDigitalWrite(SELF_RIGHT_RIGHT_EXTEND_DO, HIGH);
+        safeFastDigitalWrite<SELF_RIGHT_RIGHT_EXTEND_DO>(HIGH);
     }
 }
 
 void selfRightRetractRight(){
     if (weaponsEnabled()){
-        safeDigitalWrite(SELF_RIGHT_RIGHT_RETRACT_DO, HIGH);
+        safeFastDigitalWrite<SELF_RIGHT_RIGHT_RETRACT_DO>(HIGH);
     }
 }
 
 void selfRightExtendBoth(){
      if (weaponsEnabled()){
-         safeDigitalWrite(SELF_RIGHT_LEFT_EXTEND_DO, HIGH);
-         safeDigitalWrite(SELF_RIGHT_RIGHT_EXTEND_DO, HIGH);
+         safeFastDigitalWrite<SELF_RIGHT_LEFT_EXTEND_DO>(HIGH);
+         safeFastDigitalWrite<SELF_RIGHT_RIGHT_EXTEND_DO>(HIGH);
      }
 }
 
 void selfRightRetractBoth(){
      if (weaponsEnabled()){
-         safeDigitalWrite(SELF_RIGHT_LEFT_RETRACT_DO, HIGH);
-         safeDigitalWrite(SELF_RIGHT_RIGHT_RETRACT_DO, HIGH);
+         safeFastDigitalWrite<SELF_RIGHT_LEFT_RETRACT_DO>(HIGH);
+         safeFastDigitalWrite<SELF_RIGHT_RIGHT_RETRACT_DO>(HIGH);
      }
 }
 
 void selfRightOff(){
-    digitalWrite(SELF_RIGHT_LEFT_EXTEND_DO, LOW);
-    digitalWrite(SELF_RIGHT_RIGHT_EXTEND_DO, LOW);
-    digitalWrite(SELF_RIGHT_LEFT_RETRACT_DO, LOW);
-    digitalWrite(SELF_RIGHT_RIGHT_RETRACT_DO, LOW);
+    fastDigitalWrite<SELF_RIGHT_LEFT_EXTEND_DO>(LOW);
+    fastDigitalWrite<SELF_RIGHT_RIGHT_EXTEND_DO>(LOW);
+    fastDigitalWrite<SELF_RIGHT_LEFT_RETRACT_DO>(LOW);
+    fastDigitalWrite<SELF_RIGHT_RIGHT_RETRACT_DO>(LOW);
 }
 
 
 void selfRightSafe(){
-    digitalWrite(SELF_RIGHT_LEFT_EXTEND_DO, LOW);
-    digitalWrite(SELF_RIGHT_RIGHT_EXTEND_DO, LOW);
-    digitalWrite(SELF_RIGHT_LEFT_RETRACT_DO, LOW);
-    digitalWrite(SELF_RIGHT_RIGHT_RETRACT_DO, LOW);
+    fastDigitalWrite<SELF_RIGHT_LEFT_EXTEND_DO>(LOW);
+    fastDigitalWrite<SELF_RIGHT_RIGHT_EXTEND_DO>(LOW);
+    fastDigitalWrite<SELF_RIGHT_LEFT_RETRACT_DO>(LOW);
+    fastDigitalWrite<SELF_RIGHT_RIGHT_RETRACT_DO>(LOW);
     pinMode(SELF_RIGHT_LEFT_EXTEND_DO, OUTPUT);
     pinMode(SELF_RIGHT_RIGHT_EXTEND_DO, OUTPUT);
     pinMode(SELF_RIGHT_LEFT_RETRACT_DO, OUTPUT);
@@ -92,7 +92,9 @@ enum SelfRightState {
 
 enum SelfRightOrientation checked_orientation;
 static enum SelfRightState self_right_state = UPRIGHT;
-String hammer_command;
+// the angle the hammer move is profiled toward
+static uint16_t hammer_stop_angle;
+static uint32_t hammer_command_time;
 struct SelfRightParams {
     uint16_t min_hammer_self_right_angle;
     uint16_t max_hammer_self_right_angle;
@@ -150,6 +152,12 @@ static bool hammerIsRetracted(void) {
     return (getAngle() <= RETRACT_COMPLETE_ANGLE);
 }
 
+// still swinging or falling back, the motor waits for it to settle
+static bool hammerMoving(void) {
+    int16_t velocity;
+    return hammerVelocity(&velocity) && abs(velocity) >= RETRACT_BEGIN_VEL_MAX;
+}
+
 static bool hammerSelfRightPositionAchieved(int16_t min, int16_t max)
 {
     return (min < (int16_t)getAngle() && (int16_t)getAngle() < max);
@@ -162,14 +170,29 @@ static void startHammerSelfRightPosition(int16_t min, int16_t max)
         return;
 
     hammer_move_start = micros();
+    hammer_stop_angle = (min + max) / 2;
+    retractStarted(RETRACT_SELF_RIGHT, getAngle());
     // positive speed moves the hammer in the retract direction
-    hammer_command = startElectricHammerMove(1000);
+    startElectricHammerMove(retractCommand(getAngle(), hammer_stop_angle));
+    hammer_command_time = micros();
 }
 
 static void startHammerRetract(void)
 {
     hammer_move_start = micros();
-    hammer_command = startElectricHammerMove(1000);
+    hammer_stop_angle = RETRACT_COMPLETE_ANGLE;
+    retractStarted(RETRACT_SELF_RIGHT, getAngle());
+    startElectricHammerMove(retractCommand(getAngle(), hammer_stop_angle));
+    hammer_command_time = micros();
+}
+
+// the retract profile streamed at its period while the move runs
+static void driveHammer(void)
+{
+    if(micros() - hammer_command_time >= getRetractPeriod()) {
+        hammer_command_time = micros();
+        electricHammerSpeed(retractCommand(getAngle(), hammer_stop_angle));
+    }
 }
 
 static enum SelfRightState checkHammerRetracted(const enum SelfRightState state)
@@ -177,12 +200,14 @@ static enum SelfRightState checkHammerRetracted(const enum SelfRightState state)
     enum SelfRightState result = state;
     if(hammerIsRetracted()) {
         stopElectricHammerMove();
+        retractFinished(getAngle(), true);
         result = WAIT_VENT;
     } else if((micros() - hammer_move_start)>params.max_hammer_move_duration) {
         stopElectricHammerMove();
+        retractFinished(getAngle(), false);
         result = WAIT_VENT;
     } else {
-        DriveSerial.println(hammer_command);
+        driveHammer();
     }
     return result;
 }
@@ -223,7 +248,7 @@ static enum SelfRightState checkOrientation(const enum SelfRightState state)
     enum SelfRightState result = state;
     discretizeOrientation();
     if((checked_orientation != SR_NO_ACTION) &&
-       (checked_orientation != SR_UPRIGHT)) {
+       (checked_orientation != SR_UPRIGHT) && !hammerMoving()) {
         if(hammerSelfRightPositionAchieved(params.min_hammer_self_right_angle,
                                            params.max_hammer_self_right_angle)) {
             result = EXTEND;
@@ -240,6 +265,7 @@ static enum SelfRightState checkHammerPositioned(const enum SelfRightState state
 {
     enum SelfRightState result=state;
     if(getOrientation()==ORN_UPRIGHT) {
+        retractFinished(getAngle(), false);
         startHammerRetract();
         selfRightSafe();
         result = WAIT_HAMMER_RETRACT;
@@ -247,10 +273,13 @@ static enum SelfRightState checkHammerPositioned(const enum SelfRightState state
                                               params.max_hammer_self_right_angle) ||
               (micros() - hammer_move_start > params.max_hammer_move_duration)) {
         stopElectricHammerMove();
-        safeDigitalWrite(VENT_VALVE_DO, HIGH);
+        retractFinished(getAngle(),
+                        hammerSelfRightPositionAchieved(params.min_hammer_self_right_angle,
+                                                        params.max_hammer_self_right_angle));
+        safeFastDigitalWrite<VENT_VALVE_DO>(HIGH);
         result = EXTEND;
     } else {
-        DriveSerial.println(hammer_command);
+        driveHammer();
     }
     return result;
 }
@@ -277,13 +306,13 @@ static enum SelfRightState checkUpright(const enum SelfRightState state)
     enum SelfRightState result=state;
     if(getOrientation() == ORN_UPRIGHT) {
         // Make sure we're vented
-        safeDigitalWrite(VENT_VALVE_DO, LOW);
+        safeFastDigitalWrite<VENT_VALVE_DO>(LOW);
         selfRightSafe();
         extend_vent_start = micros();
         startHammerRetract();
         result = WAIT_HAMMER_RETRACT;
     } else if((micros() - reorient_start) > params.max_reorient_duration) {
-        safeDigitalWrite(VENT_VALVE_DO, LOW);
+        safeFastDigitalWrite<VENT_VALVE_DO>(LOW);
         selfRightSafe();
         extend_vent_start = micros();
         result = WAIT_LOCKOUT_VENT;
@@ -335,6 +364,7 @@ void autoSelfRight(bool enabled) {
         if(self_right_state == WAIT_HAMMER_POSITIONED ||
            self_right_state == WAIT_HAMMER_RETRACT) {
             stopElectricHammerMove();
+            retractFinished(getAngle(), false);
         }
         self_right_state = UPRIGHT;
         return;
@@ -3,6 +3,8 @@
 #include "pins.h"
 // #include "imu.h"
 #include "drive.h"
+#include "hammer_velocity.h"
+#include "adc_scan.h"
 
 
 static uint16_t cached_angle;
@@ -18,7 +20,13 @@ void sensorSetup(){
 
 // static const uint32_t pressure_sensor_range = 920 - 102;
 bool readMlhPressure(int16_t* pressure){
-    uint16_t counts = analogRead(PRESSURE_AI);
+    uint16_t counts;
+    uint32_t time;
+    return adcLatest(ADC_PRESSURE, &counts, &time) &&
+           pressureFromCounts(counts, pressure);
+}
+
+bool pressureFromCounts(uint16_t counts, int16_t* pressure){
     if (counts < 102) {
         *pressure = 0;
         return true;
@@ -37,8 +45,22 @@ bool readMlhPressure(int16_t* pressure){
 #define MAX_ANGLE_ANALOG_READ 920
 // 0 deg is 10% of input voltage, empirically observed to be 100 counts
 // 360 deg is 90% of input voltage, empirically observed to be 920 counts
+// every read also feeds the velocity estimate, at the conversion time so
+// reading one slot twice adds nothing
 bool readAngle(uint16_t* angle){
-    uint16_t counts = analogRead(ANGLE_AI);
+    uint16_t counts;
+    uint32_t time;
+    bool ok = adcLatest(ADC_ANGLE, &counts, &time) &&
+              angleFromCounts(counts, angle);
+    if (ok) {
+        hammerVelocitySample(time, *angle);
+    } else {
+        hammerVelocityReset();
+    }
+    return ok;
+}
+
+bool angleFromCounts(uint16_t counts, uint16_t* angle){
     if ( counts < MIN_ANGLE_ANALOG_READ ) {
         // Failure mode in shock, rails to 0;
         return false;
@@ -58,12 +80,15 @@ bool readAngle(uint16_t* angle){
 }
 
 
+// the newest conversions, a failed angle keeps the last good one
 uint16_t getAngle(void) {
+    readAngle(&cached_angle);
     return cached_angle;
 }
 
 
 int16_t getPressure(void) {
+    readMlhPressure(&cached_pressure);
     return cached_pressure;
 }
 
@@ -72,14 +97,19 @@ int16_t getPressure(void) {
 
 bool readVacuum(int16_t* left, int16_t* right)
 {
-    *left = analogRead(VACUUM_AI_LEFT);
-    *right = analogRead(VACUUM_AI_RIGHT);
+    uint16_t left_counts = 0, right_counts = 0;
+    uint32_t time;
+    adcLatest(ADC_VACUUM_LEFT, &left_counts, &time);
+    adcLatest(ADC_VACUUM_RIGHT, &right_counts, &time);
+    *left = left_counts;
+    *right = right_counts;
     return MIN_VACUUM < *left && *left < MAX_VACUUM &&
            MIN_VACUUM < *right && *right < MAX_VACUUM;
 }
 
 void getVacuum(int16_t* left, int16_t* right)
 {
+    readVacuum(&vacuum_left, &vacuum_right);
     *left = vacuum_left;
     *right = vacuum_right;
 }
@@ -89,72 +119,3 @@ bool readSensors(void) {
            readMlhPressure(&cached_pressure) &&
            readVacuum(&vacuum_left, &vacuum_right);
 }
-
-
-#define ANGLE_CONVERSION_FLOAT 0.4400978f  // 360 / (920 - 102)
-bool readAngleFloat(float* angle){
-    uint16_t counts = analogRead(ANGLE_AI);
-    if ( counts < MIN_ANGLE_ANALOG_READ ) { return false; } // Failure mode in shock, rails to 0;
-    if ( counts < ZERO_ANGLE_ANALOG_READ ) { *angle = 0.0; return true; }
-    if ( counts > MAX_ANGLE_ANALOG_READ ) { *angle = 359.9; return true; }
-
-    *angle = (float) (counts - ZERO_ANGLE_ANALOG_READ) * ANGLE_CONVERSION_FLOAT;
-    return true;
-}
-
-
-bool angularVelocity (float* angular_velocity) {
-    // This function could filter low angle values and ignore them for summing.
-    // If we only rail to 0V, we could still get a velocity.
-    float angle_traversed = 0;
-    float abs_angle_traversed = 0;
-    float last_angle;
-    bool angle_read_ok = readAngleFloat(&last_angle);
-    float new_angle;
-    float delta;
-    uint32_t read_time = micros();
-    // Take 50 readings. This should be ~25 ms. 1 rps = 2.78 deg/s
-    uint8_t num_readings = 50;
-    for (uint8_t i = 0; i < num_readings; i++) {
-        if (readAngleFloat(&new_angle)) {
-            delta = new_angle - last_angle;
-            abs_angle_traversed += abs(delta);
-            angle_traversed += delta;
-            last_angle = new_angle;
-            delayMicroseconds(300);
-        } else {
-            angle_read_ok = false;
-        }
-    }
-    // if angle read ever sketchy or if data too noisy, do not return angular velocity
-    if (angle_read_ok && abs(angle_traversed) - angle_traversed < num_readings * 2) {
-        float read_time_seconds = (float) (micros() - read_time) / 1000000.0f;    // convert to milliseconds
-        *angular_velocity = angle_traversed / read_time_seconds;  // degrees per second
-        return true;
-    } else {
-        return false;
-    }
-}
-
-// Returns absolute angular velocity in deg/sec
-bool angularVelocityBuffered (float* angular_velocity, const uint16_t* angle_data, uint16_t datapoints_buffered, uint16_t timestep_ms ) {
-    const uint32_t DATAPOINTS_TO_AVERAGE = 20;
-    // do not report velocity if too few datapoints have been buffered
-    if (datapoints_buffered < DATAPOINTS_TO_AVERAGE) {
-        return false;
-    }
-    
-    uint32_t angle_min = 360;
-    uint32_t angle_max = 0;
-    for (uint16_t i = datapoints_buffered - DATAPOINTS_TO_AVERAGE; i < datapoints_buffered; i++) {
-        if (angle_data[i] < angle_min) { 
-           angle_min = angle_data[i];
-         }
-        if (angle_data[i] > angle_max) { 
-            angle_max = angle_data[i];
-          }
-    }
-
-    *angular_velocity = (angle_max - angle_min) * 1000 / (DATAPOINTS_TO_AVERAGE * timestep_ms);
-    return true;
-}
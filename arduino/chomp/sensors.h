@@ -4,8 +4,10 @@
 void sensorSetup();
 bool readMlhPressure(int16_t* pressure);
 bool readAngle(uint16_t* angle);
-bool angularVelocity(float* angular_velocity);
-bool angularVelocityBuffered(float* angular_velocity, const uint16_t* angle_data, uint16_t datapoints_buffered, uint16_t timestep_ms);
+// the conversions behind readMlhPressure and readAngle, for counts the
+// ADC took some other way
+bool pressureFromCounts(uint16_t counts, int16_t* pressure);
+bool angleFromCounts(uint16_t counts, uint16_t* angle);
 void readImu(float* our_forward_vel, float* our_angular_vel);
 void resetImu();
 bool readSensors(void);
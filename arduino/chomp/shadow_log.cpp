@@ -0,0 +1,142 @@
+#include <Arduino.h>
+#include "shadow_log.h"
+#include "telem.h"
+#include "utils.h"
+
+// one entry per packet every 20ms keeps a dump under 3kB/s on the link
+#define SHADOW_DUMP_PERIOD 20000UL
+
+static struct ShadowEntry entries[SHADOW_LOG_LENGTH];
+static uint8_t newest = SHADOW_LOG_LENGTH - 1;
+static uint8_t count = 0;
+static struct ShadowTotals totals;
+
+static bool dumping = false;
+static bool clear_after_dump = false;
+static uint8_t dump_index = 0;
+static uint32_t last_dump_time = 0;
+
+static struct ShadowEntry *append(uint32_t time, uint8_t event) {
+    newest = (newest + 1) % SHADOW_LOG_LENGTH;
+    if(count < SHADOW_LOG_LENGTH) {
+        count++;
+    }
+    struct ShadowEntry *entry = &entries[newest];
+    entry->time = time;
+    entry->event = event;
+    entry->repeats = 0;
+    entry->intensity = 0;
+    entry->x = 0;
+    entry->y = 0;
+    entry->swing = 0;
+    entry->strike = -1;
+    return entry;
+}
+
+// 16us units, saturated to the entry fields
+static uint16_t swingTicks(int32_t swing) {
+    return clip(swing >> 4, 0L, 65535L);
+}
+
+static int16_t strikeTicks(int32_t strike) {
+    return strike < 0 ? -1 : clip(strike >> 4, 0L, 32767L);
+}
+
+static void increment(uint16_t *total) {
+    if(*total < 65535) {
+        (*total)++;
+    }
+}
+
+static int32_t rangeSq(int16_t x, int16_t y) {
+    return (int32_t)x*x + (int32_t)y*y;
+}
+
+// the soonest strike, or with none or the same one the landing point
+// nearest the robot
+static bool closer(const struct ShadowEntry &entry, int16_t strike,
+                   int16_t x, int16_t y) {
+    if(strike >= 0 && (entry.strike < 0 || strike < entry.strike)) {
+        return true;
+    }
+    return strike == entry.strike &&
+           rangeSq(x, y) < rangeSq(entry.x, entry.y);
+}
+
+void shadowLogFrame(uint32_t time, enum AutofireState state,
+                    int16_t intensity, int32_t swing, int32_t strike,
+                    Millimeters x, Millimeters y) {
+    if(dumping) {
+        return;
+    }
+    increment(&totals.frames[state]);
+    bool fold = count > 0 && entries[newest].event == state &&
+                entries[newest].repeats < 65535;
+    // no target and lockout frames carry nothing but their count
+    if(state == AF_NO_TARGET || state == AF_OMEGAZ_LOCKOUT) {
+        if(fold) {
+            entries[newest].repeats++;
+        } else {
+            append(time, state);
+        }
+        return;
+    }
+    int16_t x_mm = clip(x.toInt(), -32768L, 32767L);
+    int16_t y_mm = clip(y.toInt(), -32768L, 32767L);
+    int16_t strike_ticks = strikeTicks(strike);
+    struct ShadowEntry *entry;
+    if(fold) {
+        entry = &entries[newest];
+        entry->repeats++;
+        if(!closer(*entry, strike_ticks, x_mm, y_mm)) {
+            return;
+        }
+    } else {
+        entry = append(time, state);
+    }
+    // strike counts from the frame that predicted it
+    entry->time = time;
+    entry->intensity = intensity;
+    entry->x = x_mm;
+    entry->y = y_mm;
+    entry->swing = swingTicks(swing);
+    entry->strike = strike_ticks;
+}
+
+void shadowLogFire(uint32_t time, int16_t intensity, bool autofire) {
+    if(dumping) {
+        return;
+    }
+    increment(autofire ? &totals.auto_fires : &totals.manual_fires);
+    struct ShadowEntry *entry = append(
+        time, autofire ? SHADOW_AUTO_FIRE : SHADOW_MANUAL_FIRE);
+    entry->intensity = intensity;
+}
+
+void startShadowLogDump(bool clear) {
+    dumping = true;
+    clear_after_dump = clear;
+    dump_index = 0;
+}
+
+void shadowLogDumpStep(uint32_t now) {
+    if(!dumping || now - last_dump_time < SHADOW_DUMP_PERIOD) {
+        return;
+    }
+    last_dump_time = now;
+    if(dump_index < count) {
+        uint8_t oldest = (newest + SHADOW_LOG_LENGTH + 1 - count) %
+                         SHADOW_LOG_LENGTH;
+        const struct ShadowEntry &entry =
+            entries[(oldest + dump_index) % SHADOW_LOG_LENGTH];
+        sendShadowLogTelemetry(dump_index, count, entry, totals);
+        dump_index++;
+    }
+    if(dump_index >= count) {
+        if(clear_after_dump) {
+            count = 0;
+            memset(&totals, 0, sizeof(totals));
+        }
+        dumping = false;
+    }
+}
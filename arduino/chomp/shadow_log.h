@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+#include "autofire.h"
+#include "fixed.h"
+
+// Every autofire decision and every hammer fire, kept in RAM whether or
+// not autofire is enabled, so a match can be scored offline afterwards:
+// a fire with no HIT or ARMED frame just before it is a miss by autofire,
+// an ARMED frame with no fire after it is a shot autofire would have taken.
+// Only state changes and fires take an entry, each run of identical frames
+// folds into the entry that started it, keeping the closest prediction of
+// the run. Ten engagements a minute at about four changes each fills the
+// 1kB ring in a minute and a half, dump it between rounds. The per state
+// frame and fire totals cover the whole match even if the ring wraps.
+#define SHADOW_LOG_LENGTH 64
+#define SHADOW_STATES 5
+
+enum ShadowEvent {
+    // 0 to 4 are AutofireState
+    SHADOW_MANUAL_FIRE = 16,
+    SHADOW_AUTO_FIRE = 17,
+};
+
+struct ShadowEntry {
+    uint32_t time;       // micros() of the fire or of the frame whose
+                         // prediction is kept, time + strike is the strike
+    uint8_t event;       // AutofireState or ShadowEvent
+    uint8_t intensity;
+    uint16_t repeats;    // identical frames folded in after this one
+    int16_t x;           // predicted strike point, mm
+    int16_t y;
+    uint16_t swing;      // swing duration used, 16us units
+    int16_t strike;      // time to the strike, 16us units, -1 for none
+};
+
+// since the last clear, saturating
+struct ShadowTotals {
+    uint16_t frames[SHADOW_STATES];  // by AutofireState
+    uint16_t manual_fires;
+    uint16_t auto_fires;
+};
+
+void shadowLogFrame(uint32_t time, enum AutofireState state,
+                    int16_t intensity, int32_t swing, int32_t strike,
+                    Millimeters x, Millimeters y);
+void shadowLogFire(uint32_t time, int16_t intensity, bool autofire);
+
+// Send the ring oldest first, one entry per packet, paced from the main
+// loop by shadowLogDumpStep. Logging pauses until the dump is done, clear
+// empties the ring after it.
+void startShadowLogDump(bool clear);
+void shadowLogDumpStep(uint32_t now);
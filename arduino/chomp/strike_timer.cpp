@@ -0,0 +1,57 @@
+#include <Arduino.h>
+#include <util/atomic.h>
+#include "strike_timer.h"
+
+// Timer4 counts at 16MHz/64, 4us a tick, so the 16 bit compare reaches 262ms
+#define STRIKE_TICK_US 4
+#define STRIKE_MAX_TICKS 65535UL
+
+static volatile bool expired = false;
+
+ISR(TIMER4_COMPA_vect) {
+    TIMSK4 &= ~(1 << OCIE4A);
+    expired = true;
+}
+
+void strikeTimerInit(void) {
+    // normal mode at clk/64, which also takes the PWM off pins 6-8, only
+    // used as digital outputs
+    TCCR4A = 0;
+    TCCR4B = (1 << CS41) | (1 << CS40);
+    TIMSK4 = 0;
+}
+
+void armStrikeTimer(uint32_t delay) {
+    uint32_t ticks = delay / STRIKE_TICK_US;
+    if(ticks > STRIKE_MAX_TICKS) {
+        ticks = STRIKE_MAX_TICKS;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        TIMSK4 &= ~(1 << OCIE4A);
+        // too close to catch the compare, it is now
+        if(ticks < 2) {
+            expired = true;
+        } else {
+            expired = false;
+            OCR4A = TCNT4 + (uint16_t)ticks;
+            TIFR4 = (1 << OCF4A);
+            TIMSK4 |= (1 << OCIE4A);
+        }
+    }
+}
+
+void cancelStrikeTimer(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        TIMSK4 &= ~(1 << OCIE4A);
+        expired = false;
+    }
+}
+
+bool strikeTimerExpired(void) {
+    bool was_expired;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        was_expired = expired;
+        expired = false;
+    }
+    return was_expired;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <stdint.h>
+
+// One shot on Timer4 compare A for the autofire strike instant. The
+// interrupt only flags the instant, the loop starts the swing, since fire()
+// runs the whole swing with sensor reads.
+void strikeTimerInit(void);
+// delay in microseconds, up to 262ms
+void armStrikeTimer(uint32_t delay);
+void cancelStrikeTimer(void);
+// true once per expiry
+bool strikeTimerExpired(void);
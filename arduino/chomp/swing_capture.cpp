@@ -0,0 +1,154 @@
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <util/atomic.h>
+#include "swing_capture.h"
+#include "adc_scan.h"
+#include "sensors.h"
+
+static void saveSwingCaptureParameters(void);
+
+struct SwingCaptureParams {
+    uint16_t sample_period;
+    uint8_t decimation;
+};
+
+static struct SwingCaptureParams EEMEM saved_params = {
+    .sample_period = 0,
+    .decimation = 1,
+};
+
+static struct SwingCaptureParams params;
+
+// two conversions a sample, each takes 104us at the ADC's clk/128
+#define MIN_SAMPLE_PERIOD 250
+#define CAPTURE_BLOCK 16
+
+static volatile uint16_t block_angle[2][CAPTURE_BLOCK];
+static volatile uint16_t block_pressure[2][CAPTURE_BLOCK];
+static volatile uint8_t fill_block;
+static volatile uint8_t fill_index;
+static volatile uint8_t full_blocks;  // bit per block waiting to be drained
+static volatile uint16_t overruns = 0;
+static volatile bool running = false;
+
+// ADC interrupt context
+void swingCapturePair(uint16_t angle_counts, uint16_t pressure_counts) {
+    if(!running) {
+        return;
+    }
+    block_angle[fill_block][fill_index] = angle_counts;
+    block_pressure[fill_block][fill_index] = pressure_counts;
+    if(++fill_index == CAPTURE_BLOCK) {
+        fill_index = 0;
+        uint8_t other = fill_block ^ 1;
+        if(full_blocks & (1 << other)) {
+            // refill this block rather than overwrite undrained data
+            overruns++;
+        } else {
+            full_blocks |= (1 << fill_block);
+            fill_block = other;
+        }
+    }
+}
+
+void swingCaptureStart(void) {
+    uint16_t period = params.sample_period < MIN_SAMPLE_PERIOD ?
+                      MIN_SAMPLE_PERIOD : params.sample_period;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        fill_block = 0;
+        fill_index = 0;
+        full_blocks = 0;
+        running = true;
+        adcScanCapture(period);
+    }
+}
+
+void swingCaptureStop(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        running = false;
+        adcScanResume();
+    }
+}
+
+// counts into the trace, a failed angle read repeats the last good angle
+// as the polled trace did
+static uint16_t appendBlock(uint8_t block, uint8_t n, uint16_t* angle_data,
+                            int16_t* pressure_data, uint16_t count,
+                            uint16_t max) {
+    for(uint8_t i = 0; i < n && count < max; i++) {
+        uint16_t angle = count > 0 ? angle_data[count - 1] : 0;
+        angleFromCounts(block_angle[block][i], &angle);
+        angle_data[count] = angle;
+        pressureFromCounts(block_pressure[block][i], &pressure_data[count]);
+        count++;
+    }
+    return count;
+}
+
+uint16_t swingCaptureDrain(uint16_t* angle_data, int16_t* pressure_data,
+                           uint16_t count, uint16_t max) {
+    uint8_t full, older;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        full = full_blocks;
+        // the block not being filled is the older one
+        older = fill_block ^ 1;
+    }
+    if(full & (1 << older)) {
+        count = appendBlock(older, CAPTURE_BLOCK, angle_data, pressure_data,
+                            count, max);
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            full_blocks &= ~(1 << older);
+        }
+    }
+    if(!running) {
+        count = appendBlock(fill_block, fill_index, angle_data, pressure_data,
+                            count, max);
+        fill_index = 0;
+    }
+    return count;
+}
+
+bool swingCaptureLatest(uint16_t* angle, int16_t* pressure, uint32_t* time) {
+    uint16_t angle_counts, pressure_counts;
+    uint32_t pressure_time;
+    // an empty slot holds 0 counts, a failed angle and no pressure
+    adcLatest(ADC_PRESSURE, &pressure_counts, &pressure_time);
+    pressureFromCounts(pressure_counts, pressure);
+    adcLatest(ADC_ANGLE, &angle_counts, time);
+    return angleFromCounts(angle_counts, angle);
+}
+
+uint16_t getSwingCaptureOverruns(void) {
+    uint16_t n;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        n = overruns;
+    }
+    return n;
+}
+
+void setSwingCaptureParameters(uint16_t sample_period, uint8_t decimation) {
+    params.sample_period = sample_period;
+    // the telemetry period is 16 bits of microseconds
+    params.decimation = decimation < 1 ? 1 : decimation > 16 ? 16 : decimation;
+    saveSwingCaptureParameters();
+}
+
+uint16_t getSwingCapturePeriod(void) {
+    if(params.sample_period == 0) {
+        return 0;
+    }
+    return params.sample_period < MIN_SAMPLE_PERIOD ?
+           MIN_SAMPLE_PERIOD : params.sample_period;
+}
+
+uint8_t getSwingTelemetryDecimation(void) {
+    return params.decimation;
+}
+
+static void saveSwingCaptureParameters(void) {
+    eeprom_write_block(&params, &saved_params, sizeof(struct SwingCaptureParams));
+}
+
+void restoreSwingCaptureParameters(void) {
+    eeprom_read_block(&params, &saved_params, sizeof(struct SwingCaptureParams));
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+
+// Angle and pressure sampled through a swing by the ADC interrupt, paced
+// by Timer1 compare B, so the trace rate no longer depends on the swing
+// loop and no loop time goes to waiting on conversions. The interrupt
+// fills one of two small blocks while the swing loop moves the other into
+// the trace. The ADC scan leaves the vacuum channels alone from start to
+// stop.
+void swingCaptureStart(void);
+void swingCaptureStop(void);
+// a sample from the ADC interrupt while capturing
+void swingCapturePair(uint16_t angle_counts, uint16_t pressure_counts);
+// Moves finished blocks, and once stopped the partial one, into the trace
+// converted to degrees and psi, up to max points. Returns the new count.
+uint16_t swingCaptureDrain(uint16_t* angle_data, int16_t* pressure_data,
+                           uint16_t count, uint16_t max);
+// newest converted sample and the micros() of its angle conversion, false
+// when the angle reading failed
+bool swingCaptureLatest(uint16_t* angle, int16_t* pressure, uint32_t* time);
+// blocks dropped because the swing loop had not drained the last one
+uint16_t getSwingCaptureOverruns(void);
+
+// Sample period in microseconds, 0 for the 2ms polled trace. Faster
+// periods fill the trace sooner, 512 points at 250us is 128ms of swing.
+// Telemetry keeps every decimation'th point.
+void setSwingCaptureParameters(uint16_t sample_period, uint8_t decimation);
+void restoreSwingCaptureParameters(void);
+uint16_t getSwingCapturePeriod(void);
+uint8_t getSwingTelemetryDecimation(void);
@@ -0,0 +1,71 @@
+#include "swing_crossing.h"
+#include "fixed_math.h"
+
+// fit times are in 4us units, four samples of them 16ms apart at most
+// stay inside 16 bits
+#define TIME_SHIFT 2
+#define MAX_CROSSING_SPAN 16383UL
+// the furthest ahead the valve timers are armed
+#define MAX_CROSSING_TIME 250000L
+
+void addAngleSample(AngleSamples& samples, uint32_t time, uint16_t angle){
+    uint8_t i = samples.count % CROSSING_SAMPLES;
+    samples.time[i] = time;
+    samples.angle[i] = angle;
+    samples.count++;
+    if (samples.count >= 2 * CROSSING_SAMPLES) {
+        samples.count -= CROSSING_SAMPLES;
+    }
+}
+
+// Centred fit before the newest sample, with every offset scaled by the
+// sample count so the means are exact: dt = n*t - sum(t), da = n*a -
+// sum(a). The crossing n*t is then sum(t) + (n*target - sum(a)) *
+// sum(dt*dt)/sum(dt*da), and with 4us units and four samples n*t is
+// already microseconds. |dt| stays under 2^14 so sum(dt*dt) is under 2^30.
+bool predictCrossing(const AngleSamples& samples, uint16_t target, uint32_t* crossing){
+    if (samples.count < CROSSING_SAMPLES) {
+        return false;
+    }
+    uint32_t newest = samples.time[(samples.count - 1) % CROSSING_SAMPLES];
+    int16_t t[CROSSING_SAMPLES];
+    int16_t sum_t = 0, sum_a = 0;
+    for (uint8_t i = 0; i < CROSSING_SAMPLES; i++) {
+        uint32_t age = newest - samples.time[i];
+        if (age > MAX_CROSSING_SPAN) {
+            return false;
+        }
+        t[i] = -(int16_t)(age >> TIME_SHIFT);
+        sum_t += t[i];
+        sum_a += samples.angle[i];
+    }
+    int32_t sum_tt = 0, sum_ta = 0;
+    for (uint8_t i = 0; i < CROSSING_SAMPLES; i++) {
+        int16_t dt = CROSSING_SAMPLES * t[i] - sum_t;
+        int16_t da = CROSSING_SAMPLES * samples.angle[i] - sum_a;
+        sum_tt += mul16x16(dt, dt);
+        sum_ta += mul16x16(dt, da);
+    }
+    if (sum_tt <= 0 || sum_ta <= 0) {
+        return false;
+    }
+    // drop low bits of sum(dt*dt) until the 11 bit angle term times it
+    // fits, fixedDivide only keeps 16 significant bits anyway
+    int16_t da = CROSSING_SAMPLES * target - sum_a;
+    uint8_t frac_bits = 0;
+    while (sum_tt >= (1L << 20)) {
+        sum_tt >>= 1;
+        frac_bits++;
+    }
+    int32_t offset = fixedDivide(da * sum_tt, sum_ta, frac_bits);
+    int32_t scaled_max = (MAX_CROSSING_TIME >> TIME_SHIFT) * CROSSING_SAMPLES;
+    if (offset > scaled_max) {
+        return false;
+    }
+    int32_t t_us = ((sum_t + offset) << TIME_SHIFT) / CROSSING_SAMPLES;
+    if (t_us > MAX_CROSSING_TIME) {
+        return false;
+    }
+    *crossing = newest + t_us;
+    return true;
+}
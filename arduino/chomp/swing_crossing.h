@@ -0,0 +1,20 @@
+#pragma once
+#include <stdint.h>
+
+// angle samples the valve crossing times are extrapolated from
+#define CROSSING_SAMPLES 4
+
+// Last few (time, angle) samples of a swing, oldest overwritten first
+struct AngleSamples {
+    uint32_t time[CROSSING_SAMPLES];
+    uint16_t angle[CROSSING_SAMPLES];
+    uint8_t count;
+};
+
+void addAngleSample(AngleSamples& samples, uint32_t time, uint16_t angle);
+
+// Time the hammer reaches target, from a least squares line through the
+// samples. False until the samples are full, while the hammer is not
+// moving toward target, when the samples span more than 16ms or when the
+// crossing is more than the valve timer can reach.
+bool predictCrossing(const AngleSamples& samples, uint16_t target, uint32_t* crossing);
@@ -0,0 +1,209 @@
+#include <Arduino.h>
+#include "swing_recorder.h"
+#include "telem.h"
+
+// a 150 byte packet every 50ms is 3kB/s, half the link
+#define SWING_DOWNLOAD_PERIOD 50000UL
+#define DELTA_ESCAPE ((int8_t)-128)
+
+struct SwingRecord {
+    uint16_t sequence;
+    uint16_t begin;        // offset of the first byte in the ring
+    uint16_t length;       // compressed bytes
+    uint16_t datapoints;
+    uint16_t sample_period;
+    uint16_t throw_close;
+    uint16_t vent_open;
+    uint16_t start_angle;
+    uint8_t intensity;
+    uint8_t autofire;
+};
+
+static uint8_t ring[SWING_RECORDER_BYTES];
+static uint16_t ring_head = 0;   // next byte written
+static uint16_t ring_used = 0;
+static struct SwingRecord records[SWING_RECORDER_SWINGS];
+static uint8_t oldest = 0;
+static uint8_t num_records = 0;
+static uint16_t next_sequence = 1;
+
+static struct SwingDownload {
+    bool active;
+    uint16_t sequence;
+    uint16_t position;     // bytes into the record
+    uint16_t first;        // next point to send
+    int16_t angle;         // last decoded values, the deltas' base
+    int16_t pressure;
+    uint32_t last_time;
+} download;
+
+static void dropOldest(void) {
+    ring_used -= records[oldest].length;
+    oldest = (oldest + 1) % SWING_RECORDER_SWINGS;
+    num_records--;
+}
+
+// room for n more bytes behind the swing being written, which is newest
+static bool makeRoom(uint16_t n) {
+    while(ring_used + n > SWING_RECORDER_BYTES) {
+        if(num_records <= 1) {
+            return false;
+        }
+        dropOldest();
+    }
+    return true;
+}
+
+static void putByte(uint8_t b) {
+    ring[ring_head] = b;
+    ring_head = (ring_head + 1) % SWING_RECORDER_BYTES;
+    ring_used++;
+}
+
+static uint8_t getByte(uint16_t offset) {
+    return ring[offset % SWING_RECORDER_BYTES];
+}
+
+// one value against the last, false when out of room
+static bool putDelta(int16_t value, int16_t last, uint16_t *length) {
+    int16_t delta = value - last;
+    if(delta > -128 && delta < 128) {
+        if(!makeRoom(1)) {
+            return false;
+        }
+        putByte((uint8_t)delta);
+        *length += 1;
+    } else {
+        if(!makeRoom(3)) {
+            return false;
+        }
+        putByte((uint8_t)DELTA_ESCAPE);
+        putByte(value & 0xff);
+        putByte((uint16_t)value >> 8);
+        *length += 3;
+    }
+    return true;
+}
+
+static int16_t getDelta(uint16_t begin, uint16_t *position, int16_t last) {
+    int8_t delta = getByte(begin + *position);
+    *position += 1;
+    if(delta != DELTA_ESCAPE) {
+        return last + delta;
+    }
+    uint16_t value = getByte(begin + *position);
+    value |= (uint16_t)getByte(begin + *position + 1) << 8;
+    *position += 2;
+    return value;
+}
+
+void recordSwing(const uint16_t* angle_data, const int16_t* pressure_data,
+                 uint16_t datapoints, uint16_t sample_period,
+                 uint16_t throw_close, uint16_t vent_open,
+                 uint16_t start_angle, uint8_t intensity, bool autofire) {
+    if(num_records == SWING_RECORDER_SWINGS) {
+        dropOldest();
+    }
+    uint8_t slot = (oldest + num_records) % SWING_RECORDER_SWINGS;
+    num_records++;
+    struct SwingRecord &record = records[slot];
+    record.sequence = next_sequence++;
+    record.begin = ring_head;
+    record.length = 0;
+    uint16_t step = (datapoints + SWING_RECORD_POINTS - 1) / SWING_RECORD_POINTS;
+    if(step < 1) {
+        step = 1;
+    }
+    record.sample_period = sample_period * step;
+    record.throw_close = throw_close / step;
+    record.vent_open = vent_open / step;
+    record.start_angle = start_angle;
+    record.intensity = intensity;
+    record.autofire = autofire;
+
+    int16_t angle = 0, pressure = 0;
+    uint16_t n = 0;
+    for(uint16_t i = 0; i < datapoints; i += step) {
+        uint16_t length = record.length;
+        if(!putDelta(angle_data[i], angle, &length) ||
+           !putDelta(pressure_data[i], pressure, &length)) {
+            // the whole recorder is this swing, end on a whole sample
+            uint16_t partial = length - record.length;
+            ring_head = (ring_head + SWING_RECORDER_BYTES - partial) %
+                        SWING_RECORDER_BYTES;
+            ring_used -= partial;
+            break;
+        }
+        record.length = length;
+        angle = angle_data[i];
+        pressure = pressure_data[i];
+        n++;
+    }
+    record.datapoints = n;
+    // a download of a swing that was just pushed out has nothing to send
+    if(download.active && download.sequence != record.sequence) {
+        bool found = false;
+        for(uint8_t r = 0; r < num_records; r++) {
+            found |= records[(oldest + r) % SWING_RECORDER_SWINGS].sequence ==
+                     download.sequence;
+        }
+        download.active = found;
+    }
+}
+
+void startSwingDownload(uint16_t sequence) {
+    download.active = true;
+    download.sequence = sequence;
+    download.position = 0;
+    download.first = 0;
+    download.angle = 0;
+    download.pressure = 0;
+}
+
+void swingDownloadStep(uint32_t now) {
+    if(!download.active || now - download.last_time < SWING_DOWNLOAD_PERIOD) {
+        return;
+    }
+    download.last_time = now;
+    uint16_t oldest_sequence = num_records ? records[oldest].sequence : 0;
+    uint16_t newest_sequence = num_records ? next_sequence - 1 : 0;
+    const struct SwingRecord *record = NULL;
+    for(uint8_t r = 0; r < num_records; r++) {
+        const struct SwingRecord &candidate =
+            records[(oldest + r) % SWING_RECORDER_SWINGS];
+        if(candidate.sequence == download.sequence) {
+            record = &candidate;
+        }
+    }
+    if(record == NULL) {
+        sendSwingRecordTelemetry(download.sequence, oldest_sequence,
+                                 newest_sequence, 0, 0, 0, 0, 0, 0, false,
+                                 0, 0, NULL, NULL);
+        download.active = false;
+        return;
+    }
+
+    uint16_t angle[SWING_RECORD_TELEM_POINTS];
+    int16_t pressure[SWING_RECORD_TELEM_POINTS];
+    uint8_t n = 0;
+    while(n < SWING_RECORD_TELEM_POINTS &&
+          download.first + n < record->datapoints) {
+        download.angle = getDelta(record->begin, &download.position,
+                                  download.angle);
+        download.pressure = getDelta(record->begin, &download.position,
+                                     download.pressure);
+        angle[n] = download.angle;
+        pressure[n] = download.pressure;
+        n++;
+    }
+    sendSwingRecordTelemetry(record->sequence, oldest_sequence,
+                             newest_sequence, record->sample_period,
+                             record->datapoints, record->throw_close,
+                             record->vent_open, record->start_angle,
+                             record->intensity, record->autofire,
+                             download.first, n, angle, pressure);
+    download.first += n;
+    if(download.first >= record->datapoints) {
+        download.active = false;
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+
+// The last few swings, delta compressed, so traces survive the next
+// swing and can be pulled over the link after a fight. Each sample is an
+// angle and a pressure change of a byte each, a change that does not fit
+// is an escape byte and the raw value. A trace longer than
+// SWING_RECORD_POINTS keeps every Nth point to fit, so a swing is about
+// 140 bytes and the ring holds the last three. New swings push out the
+// oldest, a swing longer than the whole recorder keeps its start.
+#define SWING_RECORDER_BYTES 512
+#define SWING_RECORDER_SWINGS 3
+#define SWING_RECORD_POINTS 64
+
+void recordSwing(const uint16_t* angle_data, const int16_t* pressure_data,
+                 uint16_t datapoints, uint16_t sample_period,
+                 uint16_t throw_close, uint16_t vent_open,
+                 uint16_t start_angle, uint8_t intensity, bool autofire);
+
+// Send a stored swing by sequence number, 32 points a packet paced from
+// the main loop by swingDownloadStep. A sequence not stored sends one
+// empty packet, which still carries the oldest and newest stored.
+void startSwingDownload(uint16_t sequence);
+void swingDownloadStep(uint32_t now);
@@ -3,14 +3,16 @@
 
 #include <stdint.h>
 #include "leddar_io.h"
-#include "track.h"
+#include "track_pool.h"
 
 uint8_t segmentObjects(const Detection (&min_detections)[LEDDAR_SEGMENTS],
                               uint32_t now,
                               Object (&objects)[8]);
 
-int8_t trackObject(uint32_t now, struct Object (&objects)[8], uint8_t num_objects,
-                   struct Track& tracked_object);
+// update the track pool from a frame of objects, returns the object
+// assigned to the primary track or -1
+int8_t trackObjects(uint32_t now, const Object (&objects)[8],
+                    uint8_t num_objects, TrackPool &pool);
 
 void setObjectSegmentationParams(int16_t p_min_object_size,
                                  int16_t p_max_object_size,
@@ -18,4 +20,7 @@ void setObjectSegmentationParams(int16_t p_min_object_size,
                                  bool p_closest_only);
 
 void restoreObjectSegmentationParameters(void);
+
+// objects dropped because segmentObjects ran out of room
+uint16_t getSegmentationOverflows(void);
 #endif  // CHUMP_TARGETING_H
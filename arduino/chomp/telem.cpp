@@ -5,6 +5,8 @@
 #include "pins.h"
 #include "DMASerial.h"
 #include "utils.h"
+#include "targeting.h"
+#include "shadow_log.h"
 
 static void saveTelemetryParmeters(void);
 
@@ -31,7 +33,12 @@ static struct TelemetryParameters EEMEM saved_params = {
             _LBV(TLM_ID_SRT)|
             _LBV(TLM_ID_TRK)|
             _LBV(TLM_ID_AF)|
-            _LBV(TLM_ID_ACK)
+            _LBV(TLM_ID_ACK)|
+            _LBV(TLM_ID_BENCH)|
+            _LBV(TLM_ID_SWGT)|
+            _LBV(TLM_ID_SHDW)|
+            _LBV(TLM_ID_SWREC)|
+            _LBV(TLM_ID_RTRT)
             )
 };
 
@@ -190,17 +197,25 @@ struct SwingTelemInner {
     uint16_t throw_close_angle;
     uint16_t start_angle;
     uint16_t datapoints;
+    uint16_t first;
+    uint32_t trigger_latency;
+    uint32_t vent_lead;
+    uint16_t angle[SWING_TELEM_POINTS];
+    int16_t pressure[SWING_TELEM_POINTS];
 } __attribute__((packed));
 typedef TelemetryPacket<TLM_ID_SWG, SwingTelemInner> SwingTelemetry;
 
 bool sendSwingTelem(uint16_t datapoints_collected,
-                    uint16_t* angle_data,
-                    int16_t* pressure_data,
+                    uint16_t first,
+                    const uint16_t* angle_data,
+                    const int16_t* pressure_data,
                     uint16_t data_collect_timestep,
                     uint16_t throw_close_timestep,
                     uint16_t vent_open_timestep,
                     uint16_t throw_close_angle,
-                    uint16_t start_angle) {
+                    uint16_t start_angle,
+                    uint32_t trigger_latency,
+                    uint32_t vent_lead) {
     CHECK_ENABLED(TLM_ID_SWG);
     SwingTelemetry tlm;
     tlm.inner.sample_period = data_collect_timestep;
@@ -209,15 +224,15 @@ bool sendSwingTelem(uint16_t datapoints_collected,
     tlm.inner.throw_close_angle = throw_close_angle;
     tlm.inner.start_angle = start_angle;
     tlm.inner.datapoints = datapoints_collected;
-    bool success = Xbee.write((unsigned char *)&tlm, sizeof(tlm)-sizeof(TLM_TERMINATOR));
-    if(success)
-    {
-        success &= Xbee.enqueue((uint8_t *)angle_data, sizeof(uint16_t)*256, NULL, NULL);
-        success &= Xbee.enqueue((uint8_t *)pressure_data, sizeof(int16_t)*256, NULL, NULL);
+    tlm.inner.first = first;
+    tlm.inner.trigger_latency = trigger_latency;
+    tlm.inner.vent_lead = vent_lead;
+    for(uint8_t i = 0; i < SWING_TELEM_POINTS; i++) {
+        bool valid = first + i < datapoints_collected;
+        tlm.inner.angle[i] = valid ? angle_data[i] : 0;
+        tlm.inner.pressure[i] = valid ? pressure_data[i] : 0;
     }
-    success &= Xbee.write((uint8_t *)&tlm.terminator, sizeof(tlm.terminator));
-
-    return success;
+    return Xbee.write((unsigned char *)&tlm, sizeof(tlm));
 }
 
 
@@ -351,6 +366,9 @@ struct TrackingTelemetryInner {
     int16_t filtered_vx;
     int16_t filtered_y;
     int16_t filtered_vy;
+    int8_t primary;
+    uint8_t valid_tracks;
+    int16_t ego_vx;
 } __attribute__((packed));
 typedef TelemetryPacket<TLM_ID_TRK, TrackingTelemetryInner> TRKTelemetry;
 bool sendTrackingTelemetry(int16_t detection_x,
@@ -360,7 +378,10 @@ bool sendTrackingTelemetry(int16_t detection_x,
                            int32_t filtered_x,
                            int32_t filtered_vx,
                            int32_t filtered_y,
-                           int32_t filtered_vy) {
+                           int32_t filtered_vy,
+                           int8_t primary,
+                           uint8_t valid_tracks,
+                           int32_t ego_vx) {
     CHECK_ENABLED(TLM_ID_TRK);
     TRKTelemetry tlm;
     tlm.inner.detection_x = detection_x;
@@ -371,6 +392,53 @@ bool sendTrackingTelemetry(int16_t detection_x,
     tlm.inner.filtered_vx = (int16_t)clip(filtered_vx, -32768L, 32767L);
     tlm.inner.filtered_y = (int16_t)clip(filtered_y, -32768L, 32767L);
     tlm.inner.filtered_vy = (int16_t)clip(filtered_vy, -32768L, 32767L);
+    tlm.inner.primary = primary;
+    tlm.inner.valid_tracks = valid_tracks;
+    tlm.inner.ego_vx = (int16_t)clip(ego_vx, -32768L, 32767L);
+    return Xbee.write((unsigned char *)&tlm, sizeof(tlm));
+}
+
+struct TrackQualityTelemetryInner {
+    int8_t track;
+    uint8_t updates;
+    int16_t mean_rx;
+    int16_t mean_ry;
+    uint32_t var_rx;
+    uint32_t var_ry;
+    uint16_t mean_nis;
+    uint16_t gate_rejections;
+    uint16_t resets;
+} __attribute__((packed));
+typedef TelemetryPacket<TLM_ID_TRKQ, TrackQualityTelemetryInner> TRKQTelemetry;
+
+// one axis's innovation variance in mm^2
+static uint32_t innovationVariance(int32_t sum, uint32_t sum_sq,
+                                   uint8_t count) {
+    int32_t mean = sum / count;
+    int32_t variance = (int32_t)(sum_sq / count) - mean*mean;
+    return variance > 0 ? variance : 0;
+}
+
+bool sendTrackQualityTelemetry(int8_t track, const InnovationStats &stats) {
+    CHECK_ENABLED(TLM_ID_TRKQ);
+    TRKQTelemetry tlm;
+    tlm.inner.track = track;
+    tlm.inner.updates = stats.count;
+    tlm.inner.mean_rx = tlm.inner.mean_ry = 0;
+    tlm.inner.var_rx = tlm.inner.var_ry = 0;
+    tlm.inner.mean_nis = 0;
+    if(stats.count > 0) {
+        tlm.inner.mean_rx = stats.sum_rx / stats.count;
+        tlm.inner.mean_ry = stats.sum_ry / stats.count;
+        tlm.inner.var_rx = innovationVariance(stats.sum_rx, stats.sum_rx2,
+                                              stats.count);
+        tlm.inner.var_ry = innovationVariance(stats.sum_ry, stats.sum_ry2,
+                                              stats.count);
+        uint32_t mean_nis = stats.sum_nis / stats.count;
+        tlm.inner.mean_nis = mean_nis > 65535 ? 65535 : mean_nis;
+    }
+    tlm.inner.gate_rejections = stats.gate_rejections;
+    tlm.inner.resets = stats.resets;
     return Xbee.write((unsigned char *)&tlm, sizeof(tlm));
 }
 
@@ -378,15 +446,18 @@ bool sendTrackingTelemetry(int16_t detection_x,
 struct AutofireTelemetryInner {
     int8_t state;
     int32_t swing;
+    int32_t strike;
     int16_t x;
     int16_t y;
 } __attribute__((packed));
 typedef TelemetryPacket<TLM_ID_AF, AutofireTelemetryInner> AFTelemetry;
-bool sendAutofireTelemetry(enum AutofireState st, int32_t swing, int32_t x, int32_t y) {
+bool sendAutofireTelemetry(enum AutofireState st, int32_t swing, int32_t strike,
+                           int32_t x, int32_t y) {
     CHECK_ENABLED(TLM_ID_AF);
     AFTelemetry tlm;
     tlm.inner.state = st;
     tlm.inner.swing = swing;
+    tlm.inner.strike = strike;
     tlm.inner.x = (int16_t)clip(x, -32768L, 32767L);
     tlm.inner.y = (int16_t)clip(y, -32768L, 32767L);
     return Xbee.write((unsigned char *)&tlm, sizeof(tlm));
@@ -415,9 +486,13 @@ struct AutodriveTelemetryInner {
     int16_t vtheta;
     int16_t radius;
     int16_t vradius;
+    int16_t rate_setpoint;
+    int16_t rate_error;
+    int16_t rate_integral;
 } __attribute__((packed));
 typedef TelemetryPacket<TLM_ID_ADRV, AutodriveTelemetryInner> ADRVTelemetry;
-bool sendAutodriveTelemetry(int16_t steer_bias, int16_t drive_bias, int16_t theta, int16_t vtheta, int16_t r, int16_t vr) {
+bool sendAutodriveTelemetry(int16_t steer_bias, int16_t drive_bias, int16_t theta, int16_t vtheta, int16_t r, int16_t vr,
+                            int16_t rate_setpoint, int16_t rate_error, int16_t rate_integral) {
     CHECK_ENABLED(TLM_ID_ADRV);
     ADRVTelemetry tlm;
     tlm.inner.steer_bias = steer_bias;
@@ -426,6 +501,9 @@ bool sendAutodriveTelemetry(int16_t steer_bias, int16_t drive_bias, int16_t thet
     tlm.inner.vtheta = vtheta;
     tlm.inner.radius = r;
     tlm.inner.vradius = vr;
+    tlm.inner.rate_setpoint = rate_setpoint;
+    tlm.inner.rate_error = rate_error;
+    tlm.inner.rate_integral = rate_integral;
     return Xbee.write((unsigned char *)&tlm, sizeof(tlm));
 }
 
@@ -466,6 +544,8 @@ struct ObjectsMeasuredInner {
    uint8_t left_edge[8];
    uint8_t right_edge[8];
    int16_t object_sum_distance[8];
+   uint8_t partial;     // bit i set if object i is partially visible
+   uint16_t overflows;  // objects dropped by the segmenter since boot
 } __attribute__((packed));
 typedef TelemetryPacket<TLM_ID_OBJM, ObjectsMeasuredInner> ObjectsMeasuredTelemetry;
 bool sendObjectsCalculatedTelemetry(uint8_t num_objects, const Object (&objects)[8])
@@ -476,10 +556,10 @@ bool sendObjectsCalculatedTelemetry(uint8_t num_objects, const Object (&objects)
     int i=0;
     for(; i<num_objects; i++)
     {
-        tlm.inner.object_radius[i] = objects[i].radius();
-        tlm.inner.object_angle[i] = objects[i].angle();
-        tlm.inner.object_x[i] = objects[i].xcoord();
-        tlm.inner.object_y[i] = objects[i].ycoord();
+        tlm.inner.object_radius[i] = objects[i].Radius;
+        tlm.inner.object_angle[i] = objects[i].Angle.raw();
+        tlm.inner.object_x[i] = objects[i].X.toInt();
+        tlm.inner.object_y[i] = objects[i].Y.toInt();
     }
     for(; i<8; i++)
     {
@@ -495,12 +575,17 @@ bool sendObjectsMeasuredTelemetry(uint8_t num_objects, const Object (&objects)[8
     CHECK_ENABLED(TLM_ID_OBJM);
     ObjectsMeasuredTelemetry tlm;
     tlm.inner.num_objects = num_objects;
+    tlm.inner.partial = 0;
+    tlm.inner.overflows = getSegmentationOverflows();
     int i=0;
     for(; i<num_objects; i++)
     {
         tlm.inner.left_edge[i] = objects[i].LeftEdge;
         tlm.inner.right_edge[i] = objects[i].RightEdge;
         tlm.inner.object_sum_distance[i] = objects[i].SumDistance;
+        if(objects[i].Partial) {
+            tlm.inner.partial |= 1 << i;
+        }
     }
     for(; i<8; i++)
     {
@@ -544,4 +629,150 @@ bool sendVacuumTelemetry(uint16_t sample_period,
     return success;
 }
 
+struct BenchmarkTelemInner {
+    uint8_t benchmark;
+    uint16_t iterations;
+    uint32_t cycles;
+} __attribute__((packed));
+typedef TelemetryPacket<TLM_ID_BENCH, BenchmarkTelemInner> BenchmarkTelemetry;
+
+bool sendBenchmarkTelemetry(uint8_t benchmark, uint16_t iterations,
+                            uint32_t cycles)
+{
+    CHECK_ENABLED(TLM_ID_BENCH);
+    BenchmarkTelemetry tlm;
+    tlm.inner.benchmark = benchmark;
+    tlm.inner.iterations = iterations;
+    tlm.inner.cycles = cycles;
+    return Xbee.write((unsigned char *)&tlm, sizeof(tlm));
+}
+
+struct SwingDurationTelemInner {
+    uint16_t duration[9];
+    uint8_t count[9];
+} __attribute__((packed));
+typedef TelemetryPacket<TLM_ID_SWGT, SwingDurationTelemInner> SwingDurationTelemetry;
+
+bool sendSwingDurationTelemetry(const uint16_t *duration, const uint8_t *count)
+{
+    CHECK_ENABLED(TLM_ID_SWGT);
+    SwingDurationTelemetry tlm;
+    for(uint8_t i = 0; i < 9; i++) {
+        tlm.inner.duration[i] = duration[i];
+        tlm.inner.count[i] = count[i];
+    }
+    return Xbee.write((unsigned char *)&tlm, sizeof(tlm));
+}
+
+struct ShadowLogTelemInner {
+    uint8_t index;
+    uint8_t total;
+    uint32_t time;
+    uint8_t event;
+    uint16_t repeats;
+    uint8_t intensity;
+    int16_t x;
+    int16_t y;
+    uint16_t swing;
+    int16_t strike;
+    uint16_t frames[SHADOW_STATES];
+    uint16_t manual_fires;
+    uint16_t auto_fires;
+} __attribute__((packed));
+typedef TelemetryPacket<TLM_ID_SHDW, ShadowLogTelemInner> ShadowLogTelemetry;
+
+bool sendShadowLogTelemetry(uint8_t index, uint8_t total, const ShadowEntry &entry,
+                            const ShadowTotals &totals)
+{
+    CHECK_ENABLED(TLM_ID_SHDW);
+    ShadowLogTelemetry tlm;
+    tlm.inner.index = index;
+    tlm.inner.total = total;
+    tlm.inner.time = entry.time;
+    tlm.inner.event = entry.event;
+    tlm.inner.repeats = entry.repeats;
+    tlm.inner.intensity = entry.intensity;
+    tlm.inner.x = entry.x;
+    tlm.inner.y = entry.y;
+    tlm.inner.swing = entry.swing;
+    tlm.inner.strike = entry.strike;
+    for(uint8_t i = 0; i < SHADOW_STATES; i++) {
+        tlm.inner.frames[i] = totals.frames[i];
+    }
+    tlm.inner.manual_fires = totals.manual_fires;
+    tlm.inner.auto_fires = totals.auto_fires;
+    return Xbee.write((unsigned char *)&tlm, sizeof(tlm));
+}
+
+
+struct SwingRecordTelemInner {
+    uint16_t sequence;
+    uint16_t oldest;
+    uint16_t newest;
+    uint16_t sample_period;
+    uint16_t datapoints;
+    uint16_t throw_close;
+    uint16_t vent_open;
+    uint16_t start_angle;
+    uint8_t intensity;
+    uint8_t autofire;
+    uint16_t first;
+    uint8_t count;
+    uint16_t angle[SWING_RECORD_TELEM_POINTS];
+    int16_t pressure[SWING_RECORD_TELEM_POINTS];
+} __attribute__((packed));
+typedef TelemetryPacket<TLM_ID_SWREC, SwingRecordTelemInner> SwingRecordTelemetry;
+
+bool sendSwingRecordTelemetry(uint16_t sequence, uint16_t oldest,
+                              uint16_t newest, uint16_t sample_period,
+                              uint16_t datapoints, uint16_t throw_close,
+                              uint16_t vent_open, uint16_t start_angle,
+                              uint8_t intensity, bool autofire,
+                              uint16_t first, uint8_t count,
+                              const uint16_t *angle, const int16_t *pressure)
+{
+    CHECK_ENABLED(TLM_ID_SWREC);
+    SwingRecordTelemetry tlm;
+    tlm.inner.sequence = sequence;
+    tlm.inner.oldest = oldest;
+    tlm.inner.newest = newest;
+    tlm.inner.sample_period = sample_period;
+    tlm.inner.datapoints = datapoints;
+    tlm.inner.throw_close = throw_close;
+    tlm.inner.vent_open = vent_open;
+    tlm.inner.start_angle = start_angle;
+    tlm.inner.intensity = intensity;
+    tlm.inner.autofire = autofire;
+    tlm.inner.first = first;
+    tlm.inner.count = count;
+    for(uint8_t i = 0; i < SWING_RECORD_TELEM_POINTS; i++) {
+        tlm.inner.angle[i] = i < count ? angle[i] : 0;
+        tlm.inner.pressure[i] = i < count ? pressure[i] : 0;
+    }
+    return Xbee.write((unsigned char *)&tlm, sizeof(tlm));
+}
+
+struct RetractTelemInner {
+    uint8_t source;
+    uint8_t complete;
+    uint32_t duration;
+    uint16_t start_angle;
+    uint16_t end_angle;
+    int16_t peak_speed;
+} __attribute__((packed));
+typedef TelemetryPacket<TLM_ID_RTRT, RetractTelemInner> RetractTelemetry;
 
+bool sendRetractTelemetry(uint8_t source, bool complete, uint32_t duration,
+                          uint16_t start_angle, uint16_t end_angle,
+                          int16_t peak_speed)
+{
+    CHECK_ENABLED(TLM_ID_RTRT);
+    RetractTelemetry tlm;
+    tlm.inner.source = source;
+    tlm.inner.complete = complete;
+    tlm.inner.duration = duration;
+    tlm.inner.start_angle = start_angle;
+    tlm.inner.end_angle = end_angle;
+    tlm.inner.peak_speed = peak_speed;
+    return Xbee.write((unsigned char *)&tlm, sizeof(tlm));
+}
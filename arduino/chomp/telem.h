@@ -28,6 +28,12 @@ enum TelemetryPacketId {
     TLM_ID_OBJM=21,
     TLM_ID_OBJC=22,
     TLM_ID_VAC=23,
+    TLM_ID_BENCH=24,
+    TLM_ID_TRKQ=25,
+    TLM_ID_SWGT=26,
+    TLM_ID_SHDW=27,
+    TLM_ID_SWREC=28,
+    TLM_ID_RTRT=29,
 };
 
 extern uint32_t enabled_telemetry;
@@ -36,6 +42,9 @@ extern uint32_t enabled_telemetry;
 
 // Forward decls
 struct Detection;
+struct InnovationStats;
+struct ShadowEntry;
+struct ShadowTotals;
 
 bool sendSystemTelem(uint32_t loop_speed_min, uint32_t loop_speed_avg,
                      uint32_t loop_speed_max, uint32_t loop_count,
@@ -49,14 +58,19 @@ bool sendSbusTelem(uint16_t cmd_bitfield, int16_t hammer_intensity, int16_t hamm
 bool sendDebugMessageTelem(const char *msg);
 void debug_print(const String &msg);
 bool sendLeddarTelem(const Detection (&detections)[LEDDAR_SEGMENTS], unsigned int count);
+// one packet of the trace, SWING_TELEM_POINTS from first on
+#define SWING_TELEM_POINTS 32
 bool sendSwingTelem(uint16_t datapoints_collected,
-                    uint16_t* angle_data,
-                    int16_t* pressure_data,
+                    uint16_t first,
+                    const uint16_t* angle_data,
+                    const int16_t* pressure_data,
                     uint16_t data_collect_timestep,
                     uint16_t throw_close_timestep,
                     uint16_t vent_open_timestep,
                     uint16_t throw_close_angle,
-                    uint16_t start_angle);
+                    uint16_t start_angle,
+                    uint32_t trigger_latency,
+                    uint32_t vent_lead);
 bool sendPWMTelem(bool targeting_enable, int16_t left_usec, int16_t left_drive, int16_t right_usec, int16_t right_drive, int16_t drive_distance);
 bool sendIMUTelem(int16_t (&a)[3], int16_t (&g)[3], int16_t temperature);
 bool sendORNTelem(bool stationary, uint8_t orientation, int32_t sum_angular_rate, int16_t total_norm, int16_t cross_norm);
@@ -70,10 +84,16 @@ bool sendTrackingTelemetry(int16_t detection_x,
                            int32_t filtered_x,
                            int32_t filtered_vx,
                            int32_t filtered_y,
-                           int32_t filtered_vy);
-bool sendAutofireTelemetry(enum AutofireState st, int32_t swing, int32_t x, int32_t y);
+                           int32_t filtered_vy,
+                           int8_t primary,
+                           uint8_t valid_tracks,
+                           int32_t ego_vx);
+bool sendTrackQualityTelemetry(int8_t track, const InnovationStats &stats);
+bool sendAutofireTelemetry(enum AutofireState st, int32_t swing, int32_t strike,
+                           int32_t x, int32_t y);
 bool sendCommandAcknowledge(uint8_t cmdid, uint16_t valid_commands, uint16_t invalid_commands);
-bool sendAutodriveTelemetry(int16_t steer_bias, int16_t drive_bias, int16_t theta, int16_t vtheta, int16_t r, int16_t vr);
+bool sendAutodriveTelemetry(int16_t steer_bias, int16_t drive_bias, int16_t theta, int16_t vtheta, int16_t r, int16_t vr,
+                            int16_t rate_setpoint, int16_t rate_error, int16_t rate_integral);
 bool isTimeToSendLeddarTelem(uint32_t now);
 bool isTimeToSendTelemetry(uint32_t now);
 bool isTimeToSendDriveTelemetry(uint32_t now);
@@ -88,4 +108,20 @@ bool sendVacuumTelemetry(uint16_t sample_period,
                          uint16_t datapoints_collected,
                          int16_t* left_data,
                          int16_t* right_data);
+bool sendSwingDurationTelemetry(const uint16_t *duration, const uint8_t *count);
+bool sendShadowLogTelemetry(uint8_t index, uint8_t total, const ShadowEntry &entry,
+                            const ShadowTotals &totals);
+#define SWING_RECORD_TELEM_POINTS 32
+bool sendSwingRecordTelemetry(uint16_t sequence, uint16_t oldest,
+                              uint16_t newest, uint16_t sample_period,
+                              uint16_t datapoints, uint16_t throw_close,
+                              uint16_t vent_open, uint16_t start_angle,
+                              uint8_t intensity, bool autofire,
+                              uint16_t first, uint8_t count,
+                              const uint16_t *angle, const int16_t *pressure);
+bool sendRetractTelemetry(uint8_t source, bool complete, uint32_t duration,
+                          uint16_t start_angle, uint16_t end_angle,
+                          int16_t peak_speed);
+bool sendBenchmarkTelemetry(uint8_t benchmark, uint16_t iterations,
+                            uint32_t cycles);
 #endif //TELEM_H
@@ -1,6 +1,8 @@
 #include <Arduino.h>
 #include "track.h"
 #include "utils.h"
+#include "fixed_math.h"
+#include "gyro_history.h"
 
 struct TrackingFilterParameters {
     int16_t alpha, beta;  // position, velocity filter
@@ -8,31 +10,105 @@ struct TrackingFilterParameters {
     uint32_t min_num_updates; // minimum number before trusted
     int32_t max_off_track; // squared distance in mm
     int32_t max_start_distance; // squared distance in mm
+    bool world_frame; // track in the world frame
+    bool kalman; // Kalman filter instead of alpha-beta
+    int16_t accel_noise; // process noise, mm/s^2
+    int16_t measurement_noise; // detection noise, mm
+    uint8_t gate; // maximum normalized innovation squared
 } __attribute__((packed));
 
 
-struct TrackingFilterParameters EEMEM saved_tracking_params = {
-    .alpha = 9000,
-    .beta = 8192,
-    .track_lost_dt = 250000,
-    .min_num_updates = 3,
-    .max_off_track = 1000L*1000L,
-    .max_start_distance = 6000L*6000L
-};
+#define DEFAULT_TRACKING_PARAMS {   \
+    .alpha = 9000,                  \
+    .beta = 8192,                   \
+    .track_lost_dt = 250000,        \
+    .min_num_updates = 3,           \
+    .max_off_track = 1000L*1000L,   \
+    .max_start_distance = 6000L*6000L, \
+    .world_frame = false,           \
+    .kalman = false,                \
+    .accel_noise = 3000,            \
+    .measurement_noise = 40,        \
+    .gate = 16                      \
+}
+
+struct TrackingFilterParameters EEMEM saved_tracking_params = DEFAULT_TRACKING_PARAMS;
+
+// what a new track starts with, the last parameters set or restored
+static struct TrackingFilterParameters current_params = DEFAULT_TRACKING_PARAMS;
+
+// velocity variance of a new Kalman track, (2000 mm/s)^2
+#define INITIAL_VELOCITY_VARIANCE 4000000L
+// covariance limit, (10 m)^2 or (10 m/s)^2
+#define MAX_COVARIANCE 100000000L
+
+typedef Fixed<int16_t, 15> Seconds;
+typedef Fixed<int32_t, 0> Variance;
+
+
+InnovationStats::InnovationStats() {
+    clear();
+}
+
+void InnovationStats::add(int32_t rx, int32_t ry, int32_t nis) {
+    if(count == 255) {
+        return;
+    }
+    count++;
+    sum_rx += rx;
+    sum_ry += ry;
+    sum_rx2 += rx*rx;
+    sum_ry2 += ry*ry;
+    sum_nis += nis;
+}
 
+void InnovationStats::clear(void) {
+    count = 0;
+    sum_rx = sum_ry = 0;
+    sum_rx2 = sum_ry2 = 0;
+    sum_nis = 0;
+    gate_rejections = 0;
+    resets = 0;
+}
+
+static void applyParams(Track &track, const struct TrackingFilterParameters &p) {
+    track.alpha = Fixed<int16_t, 15>::fromRaw(p.alpha);
+    track.beta = Fixed<int16_t, 12>::fromRaw(p.beta);
+    track.min_num_updates = p.min_num_updates;
+    track.track_lost_dt = p.track_lost_dt;
+    track.max_off_track = p.max_off_track;
+    track.max_start_distance = p.max_start_distance;
+    track.world_frame = p.world_frame;
+    track.kalman = p.kalman;
+    track.accel_noise = (int32_t)p.accel_noise*p.accel_noise;
+    track.measurement_noise = clip((int32_t)p.measurement_noise*p.measurement_noise,
+                                   1L, MAX_COVARIANCE);
+    track.gate = p.gate;
+}
 
+static void toParams(const Track &track, struct TrackingFilterParameters *p) {
+    p->alpha = track.alpha.raw();
+    p->beta = track.beta.raw();
+    p->min_num_updates = track.min_num_updates;
+    p->track_lost_dt = track.track_lost_dt;
+    p->max_off_track = track.max_off_track;
+    p->max_start_distance = track.max_start_distance;
+    p->world_frame = track.world_frame;
+    p->kalman = track.kalman;
+    p->accel_noise = fixedSqrt(track.accel_noise);
+    p->measurement_noise = fixedSqrt(track.measurement_noise);
+    p->gate = track.gate;
+}
+
+// starts lost under the current lost track interval, so the first
+// detection starts the track
 Track::Track() :
-        x(0), vx(0),
-        y(0), vy(0),
         num_updates(0),
-        last_update(micros()),
-        last_predict(micros()),
-        alpha(10000), beta(10000),
-        track_lost_dt(250000),
-        min_num_updates(3),
-        max_off_track(1000L*1000L),
-        max_start_distance(6000L*6000L)
-        { }
+        last_predict(micros())
+{
+    applyParams(*this, current_params);
+    last_update = micros() - track_lost_dt;
+}
 
 bool Track::recent_update(uint32_t now) const {
     uint32_t dt = (now - last_update);
@@ -40,92 +116,259 @@ bool Track::recent_update(uint32_t now) const {
 }
 
 
+// rotate a world frame vector into a body which has turned by heading
+static void toBody(Radians heading, Millimeters *px, Millimeters *py) {
+    UnitQ14 c = UnitQ14::fromRaw(fixedCos(heading.raw()));
+    UnitQ14 s = UnitQ14::fromRaw(fixedSin(heading.raw()));
+    Millimeters lx=*px;
+    Millimeters ly=*py;
+    *px = lx.mul<Millimeters>(c) + ly.mul<Millimeters>(s);
+    *py = ly.mul<Millimeters>(c) - lx.mul<Millimeters>(s);
+}
+
+static Radians wrapAngle(int32_t angle) {
+    while(angle > FIXED_PI) angle -= 2*FIXED_PI;
+    while(angle < -FIXED_PI) angle += 2*FIXED_PI;
+    return Radians::fromRaw(angle);
+}
+
+// detection position in the frame the filter runs in
+static void observed(const Track &track, const Object &detection,
+                     Millimeters *px, Millimeters *py) {
+    *px = detection.X;
+    *py = detection.Y;
+    if(track.world_frame) {
+        toBody(-track.heading, px, py);
+    }
+}
+
 // distance squared in mm
 int32_t Track::distanceSq(const Object &detection) const {
-    int32_t dx = (x/16-detection.xcoord());
-    int32_t dy = (y/16-detection.ycoord());
+    Millimeters mx, my;
+    observed(*this, detection, &mx, &my);
+    int32_t dx = (x - mx).toInt();
+    int32_t dy = (y - my).toInt();
     return dx*dx + dy*dy;
 }
 
-// return change in body angle as measured by gyro
-// radians scaled by 2048
-int16_t Track::updateOmegaZ(int32_t dt, int16_t omegaZ) {
-    // work with radians/sec scaled by 32768
-    // (2000deg/sec)/(32768 full scale)*pi/180*32768 = 34.9
-    int32_t converted = omegaZ*35;
-    int32_t average_omegaZ = (last_omgaz + converted)/2;
-    last_omgaz = converted;
-    return ((average_omegaZ/16)*(dt/1000))/1000;
-}
-
-void Track::project(int32_t dt, int32_t dtheta, int32_t *px, int32_t *py) const {
-    // predict:
-    // r = sqrt(x**2+y**2)
-    // theta = atan2(y, x)
-    // x = x + dt*vx/1e6 + r*(cos(theta-dtheta) - cos(theta))
-    // x = x + dt*vx/1e6 + r*(cos(theta)*cos(dtheta) + sin(theta)*sin(dtheta) - x/r)
-    // x = x + dt*vx/1e6 + r*((x/r)*cos(dtheta) + (y/r)*sin(dtheta) - x/r)
-    // x = x + dt*vx/1e6 + (x*cos(dtheta) + y*sin(dtheta) - x)
-    // x = x + dt*vx/1e6 + (x*(cos(dtheta)-1) + y*sin(dtheta))
-    // x = x + dt*vx/1e6 + (x*(-dtheta*dtheta/2048/2/2048) + y*dtheta/2048)
-    // x = x + dt*vx/1e6 - (x*dtheta*dtheta/2048/2 - y*dtheta)/2048
-    int32_t lx=*px;
-    int32_t ly=*py;
-    *px = lx + ((dt/1000)*vx)/1000 - ((lx*dtheta/1024L)*dtheta/4L - ly*dtheta)/2048L;
-    // y = y + dt*vy/1e6 + r*(sin(theta-dtheta) - sin(theta));
-    // y = y + dt*vy/1e6 + r*(sin(theta)*cos(dtheta) - cos(theta)*sin(dtheta) - sin(theta));
-    // y = y + dt*vy/1e6 + r*((y/r)*cos(dtheta) - (x/r)*sin(dtheta) - (y/r));
-    // y = y + dt*vy/1e6 + (y*cos(dtheta) - x*sin(dtheta) - y);
-    // y = y + dt*vy/1e6 + (y*(cos(dtheta)-1) - x*sin(dtheta));
-    // y = y + dt*vy/1e6 - (y*(dtheta*dtheta/2048/2) + x*dtheta)/2048;
-    *py = ly + ((dt/1000)*vy)/1000 - ((ly*dtheta/1024L)*dtheta/4L + lx*dtheta)/2048L;
-}
-
-int32_t Track::predict(uint32_t now, int16_t omegaZ) {
+// normalized innovation squared, r^2/S on each axis, Q4. rx and ry in mm
+// up to 2047. S is the predicted covariance plus the detection noise, the
+// detection noise alone when alpha-beta leaves the covariance alone.
+static int32_t normalizedInnovation(const Track &track, int32_t rx,
+                                    int32_t ry) {
+    int32_t sx = track.measurement_noise;
+    int32_t sy = track.measurement_noise;
+    if(track.kalman) {
+        sx += track.cx.pp;
+        sy += track.cy.pp;
+    }
+    return fixedDivide(rx*rx, sx, 4) + fixedDivide(ry*ry, sy, 4);
+}
+
+bool Track::gated(const Object &detection, int32_t distance) const {
+    if(distance >= max_off_track) {
+        return false;
+    }
+    if(!kalman) {
+        return true;
+    }
+    Millimeters mx, my;
+    observed(*this, detection, &mx, &my);
+    int32_t rx = clip((mx - x).toInt(), -2047L, 2047L);
+    int32_t ry = clip((my - y).toInt(), -2047L, 2047L);
+    return normalizedInnovation(*this, rx, ry) <= ((int32_t)gate << 4);
+}
+
+// dt microseconds in seconds, up to 1s, see MAX_STRIKE_LEAD in autofire.cpp
+static Seconds seconds(int32_t dt) {
+    // 2^15/1e6 = 2147/2^16
+    return Seconds::fromRaw((clip(dt, 0L, 999999L)*2147L) >> 16);
+}
+
+// grow one axis's covariance over dt, white acceleration noise
+static void predictCovariance(Covariance *c, Seconds dt, int32_t accel_noise) {
+    Variance q_vv = Variance::fromRaw(accel_noise).mul<Variance>(dt)
+                                                  .mul<Variance>(dt);
+    Variance q_pv = q_vv.mul<Variance>(dt);
+    Variance q_pp = q_pv.mul<Variance>(dt);
+    Variance vv_dt = Variance::fromRaw(c->vv).mul<Variance>(dt);
+    Variance pv_dt = Variance::fromRaw(c->pv).mul<Variance>(dt);
+    // pp + 2 dt pv + dt^2 vv + dt^4/4 q, pv + dt vv + dt^3/2 q, vv + dt^2 q
+    c->pp = clip(c->pp + 2*pv_dt.raw() + vv_dt.mul<Variance>(dt).raw() +
+                 q_pp.raw()/4, 0L, MAX_COVARIANCE);
+    c->pv = clip(c->pv + vv_dt.raw() + q_pv.raw()/2,
+                 -MAX_COVARIANCE, MAX_COVARIANCE);
+    c->vv = clip(c->vv + q_vv.raw(), 0L, MAX_COVARIANCE);
+}
+
+// Kalman correction of one axis by the residual r
+static void correct(Covariance *c, int32_t measurement_noise, Millimeters r,
+                    Millimeters *p, MillimetersPerSec *v) {
+    int32_t innovation_variance = c->pp + measurement_noise;
+    Fixed<int16_t, 15> k_p = Fixed<int16_t, 15>::saturated(
+        fixedDivide(c->pp, innovation_variance, 15));
+    Fixed<int16_t, 8> k_v = Fixed<int16_t, 8>::saturated(
+        fixedDivide(c->pv, innovation_variance, 8));  // 1/s
+    *p += r.mul<Millimeters>(k_p);
+    *v += r.mul<MillimetersPerSec>(k_v);
+    Variance pp = Variance::fromRaw(c->pp);
+    Variance pv = Variance::fromRaw(c->pv);
+    c->pp -= pp.mul<Variance>(k_p).raw();
+    c->pv -= pv.mul<Variance>(k_p).raw();
+    c->vv = clip(c->vv - pv.mul<Variance>(k_v).raw(), 0L, MAX_COVARIANCE);
+}
+
+// distance moved in dt microseconds
+static Millimeters travel(int32_t dt, MillimetersPerSec v) {
+    return Millimeters::fromRaw(((dt/1000)*v.raw())/1000);
+}
+
+// sin(theta)/theta and (1 - cos(theta))/theta in Q14, by series below a
+// radian where the quotients lose precision, from the trig tables above
+static void arcFactors(Radians theta, int32_t *sinc, int32_t *cosc) {
+    int32_t a = theta.raw();
+    if(a > -2048 && a < 2048) {
+        // 1 - t^2/6 + t^4/120 and t/2 - t^3/24 + t^5/720, t in Q14
+        int32_t t = a << 3;
+        int32_t t2 = (t * t) >> 14;
+        int32_t t3 = (t2 * t) >> 14;
+        int32_t t4 = (t2 * t2) >> 14;
+        int32_t t5 = (t4 * t) >> 14;
+        *sinc = FIXED_ONE_Q14 - t2 / 6 + t4 / 120;
+        *cosc = t / 2 - t3 / 24 + t5 / 720;
+    } else {
+        *sinc = fixedDivide(fixedSin(a), a, 11);
+        *cosc = fixedDivide(FIXED_ONE_Q14 - fixedCos(a), a, 11);
+    }
+}
+
+// Move a body frame position dt microseconds on, up to 1s, while the body
+// turns by dtheta at a constant rate and the target keeps its velocity
+// along the body axes. In one step, exact for any turn:
+//   d/dt p = v - omega x p
+//   p(T) = R(-theta) p0 + T (sinc(theta) I + cosc(theta) J) v
+// R(-theta) p0 = (x*cos + y*sin, y*cos - x*sin), J v = (vy, -vx)
+void Track::project(int32_t dt, Radians dtheta, Millimeters *px, Millimeters *py) const {
+    MillimetersPerSec rvx, rvy;
+    relativeVelocity(&rvx, &rvy);
+    Seconds t = seconds(dt);
+    Millimeters dx = rvx.mul<Millimeters>(t);
+    Millimeters dy = rvy.mul<Millimeters>(t);
+    int32_t sinc, cosc;
+    arcFactors(dtheta, &sinc, &cosc);
+    UnitQ14 s = UnitQ14::fromRaw(sinc);
+    UnitQ14 c = UnitQ14::fromRaw(cosc);
+    toBody(dtheta, px, py);
+    *px += dx.mul<Millimeters>(s) + dy.mul<Millimeters>(c);
+    *py += dy.mul<Millimeters>(s) - dx.mul<Millimeters>(c);
+}
+
+// target velocity less ours in the filter frame, how it moves on the LEDDAR
+void Track::relativeVelocity(MillimetersPerSec *pvx, MillimetersPerSec *pvy) const {
+    MillimetersPerSec ex = ego_vx;
+    MillimetersPerSec ey;
+    if(world_frame) {
+        toBody(-heading, &ex, &ey);
+    }
+    *pvx = vx - ex;
+    *pvy = vy - ey;
+}
+
+// move the state dt microseconds on, the body having turned by dtheta
+void Track::advance(int32_t dt, Radians dtheta) {
+    if(world_frame) {
+        MillimetersPerSec rvx, rvy;
+        relativeVelocity(&rvx, &rvy);
+        heading = wrapAngle((int32_t)heading.raw() + dtheta.raw());
+        x += travel(dt, rvx);
+        y += travel(dt, rvy);
+    } else {
+        project(dt, dtheta, &x, &y);
+    }
+}
+
+// dtheta is the body rotation since last_predict, see gyroRotation, and
+// ego our forward speed
+int32_t Track::predict(uint32_t now, Radians dtheta, MillimetersPerSec ego) {
     int32_t dt = (now - last_predict);
     last_predict = now;
-    int32_t dtheta = updateOmegaZ(dt, omegaZ);
-    project(dt, dtheta, &x, &y);
+    ego_vx = ego;
+    if(kalman) {
+        predictCovariance(&cx, seconds(dt), accel_noise);
+        predictCovariance(&cy, seconds(dt), accel_noise);
+    }
+    advance(dt, dtheta);
     return dt;
 }
 
+// The track extrapolated to now with the measured rotation, for decisions
+// between LEDDAR frames. The filter and its covariance are left alone.
+Track Track::predictAt(uint32_t now, MillimetersPerSec ego) const {
+    Track current = *this;
+    current.ego_vx = ego;
+    current.advance(now - last_predict, Radians::saturated(
+        gyroRotation(last_predict, now)));
+    current.last_predict = now;
+    return current;
+}
+
 void Track::update(const Object& best_match) {
-    int32_t mx = best_match.xcoord();
-    int32_t my = best_match.ycoord();
+    Millimeters mx, my;
+    observed(*this, best_match, &mx, &my);
     if(!recent_update(best_match.Time)) {
-        x = mx*16;
-        y = my*16;
-        vx = 0;
-        vy = 0;
+        x = mx;
+        y = my;
+        vx = MillimetersPerSec();
+        vy = MillimetersPerSec();
+        cx.pp = cy.pp = measurement_noise;
+        cx.pv = cy.pv = 0;
+        cx.vv = cy.vv = INITIAL_VELOCITY_VARIANCE;
         num_updates = 0;
+        innovations.resets++;
+    } else if(kalman) {
+        const Millimeters max_residual = Millimeters::fromRaw(65535L);
+        const MillimetersPerSec max_v = MillimetersPerSec::fromInt(10000);
+        rx = (mx - x).clip(-max_residual, max_residual);
+        ry = (my - y).clip(-max_residual, max_residual);
+        recordInnovation();
+        correct(&cx, measurement_noise, rx, &x, &vx);
+        correct(&cy, measurement_noise, ry, &y, &vy);
+        vx = vx.clip(-max_v, max_v);
+        vy = vy.clip(-max_v, max_v);
     } else {
+        const Millimeters max_residual = Millimeters::fromRaw(65535L);
+        const MillimetersPerSec max_v = MillimetersPerSec::fromInt(10000);
         //
         // residual:
         // rx = mr*cos(ma) - x
-        // rx = mr*(2048 - ma*ma/2048/2)/2048 - x
-        rx = mx*16 - x;
-        if(rx>65535L) rx=65535L;
-        if(rx<-65535L) rx=-65535L;
+        rx = (mx - x).clip(-max_residual, max_residual);
         // ry = mr*sin(ma) - y
-        ry = my*16 - y;
-        if(ry>65535L) ry=65535L;
-        if(ry<-65535L) ry=-65535L;
+        ry = (my - y).clip(-max_residual, max_residual);
+        recordInnovation();
         //
         // correct:
-        x += alpha*rx/32767;
-        y += alpha*ry/32767;
-        vx += beta*rx/4096;
-        vx = clip(vx, -10000L*16, 10000L*16);
-        vy += beta*ry/4096;
-        vy = clip(vy, -10000L*16, 10000L*16);
+        x += rx.mul<Millimeters>(alpha);
+        y += ry.mul<Millimeters>(alpha);
+        vx += rx.mul<MillimetersPerSec>(beta);
+        vx = vx.clip(-max_v, max_v);
+        vy += ry.mul<MillimetersPerSec>(beta);
+        vy = vy.clip(-max_v, max_v);
     }
     num_updates++;
     last_update = best_match.Time;
 }
 
-void Track::updateNoObs(uint32_t time, int16_t omegaZ) {
+// add the residual to the innovation statistics, before the correction
+// shrinks the covariance
+void Track::recordInnovation(void) {
+    int32_t ix = clip(rx.toInt(), -2047L, 2047L);
+    int32_t iy = clip(ry.toInt(), -2047L, 2047L);
+    innovations.add(ix, iy, normalizedInnovation(*this, ix, iy));
+}
+
+void Track::updateNoObs(uint32_t time, Radians dtheta, MillimetersPerSec ego) {
     if(recent_update(time)) {
-        predict(time, omegaZ);
+        predict(time, dtheta, ego);
     }
 }
 
@@ -138,22 +381,74 @@ bool Track::valid(uint32_t now) const {
     return recent_update(now) && (num_updates>min_num_updates);
 }
 
-int32_t Track::angle(void) const {
+// position in the body frame
+void Track::bodyPosition(Millimeters *px, Millimeters *py) const {
+    *px = x;
+    *py = y;
+    if(world_frame) {
+        toBody(heading, px, py);
+    }
+}
+
+// velocity along the body axes
+void Track::bodyVelocity(MillimetersPerSec *pvx, MillimetersPerSec *pvy) const {
+    *pvx = vx;
+    *pvy = vy;
+    if(world_frame) {
+        toBody(heading, pvx, pvy);
+    }
+}
+
+// Body frame position dt microseconds ahead while turning at omegaZ. The
+// body frame projects the whole turn in one step, the world frame moves
+// the target and rotates once by the heading it will have.
+void Track::lookahead(int32_t dt, RadiansPerSec omegaZ,
+                      Millimeters *px, Millimeters *py) const {
+    *px = x;
+    *py = y;
+    int32_t turn = ((dt/1000)*omegaZ.raw())/1000;
+    if(world_frame) {
+        MillimetersPerSec rvx, rvy;
+        relativeVelocity(&rvx, &rvy);
+        *px += travel(dt, rvx);
+        *py += travel(dt, rvy);
+        toBody(wrapAngle(heading.raw() + clip(turn, -32768L, 32767L)), px, py);
+    } else {
+        project(dt, Radians::saturated(turn), px, py);
+    }
+}
+
+Radians Track::angle(void) const {
     if(valid(micros())) {
         // arctan(y/x)
-        return ((y*2048L)/x - ((((((y*(y/16L))/x)*y)/x)*2048L)/x)*16L/3L);
+        Millimeters bx, by;
+        bodyPosition(&bx, &by);
+        return Radians::fromRaw(fixedAtan2(by.raw(), bx.raw()));
     } else {
-        return 0;
+        return Radians();
     }
 }
 
-int32_t Track::vtheta(void) const {
+RadiansPerSec Track::vtheta(void) const {
     if(valid(micros())) {
         // d/dt arctan(y/x) = (1/(1+(y/x)**2))*(vy/x - y*vx/x**2)
         // (vy*x-vx*y)/(x**2+y**2)
-        return vy*2048/x; // (vy*x - vx*y)*128L/(x*x/16L + y*y/16L);
+        // the cross product is the same in either frame, the bearing
+        // moves with the relative velocity
+        // work in whole mm, clipped to keep the products in 32 bits
+        typedef Fixed<int32_t, 0> Whole;
+        const Whole max_position = Whole::fromInt(16383);
+        Whole mx = Whole::from(x).clip(-max_position, max_position);
+        Whole my = Whole::from(y).clip(-max_position, max_position);
+        MillimetersPerSec rvx, rvy;
+        relativeVelocity(&rvx, &rvy);
+        Whole mvx = Whole::from(rvx);
+        Whole mvy = Whole::from(rvy);
+        Whole num = mvy.mul<Whole>(mx) - mvx.mul<Whole>(my);
+        Whole den = mx.mul<Whole>(mx) + my.mul<Whole>(my);
+        return num.div<RadiansPerSec>(den);
     } else {
-        return 0;
+        return RadiansPerSec();
     }
 }
 
@@ -161,35 +456,44 @@ void Track::setTrackingFilterParams(int16_t p_alpha, int16_t p_beta,
                              int8_t p_min_num_updates,
                              uint32_t p_track_lost_dt,
                              int16_t p_max_off_track,
-                             int16_t p_max_start_distance
+                             int16_t p_max_start_distance,
+                             bool p_world_frame,
+                             bool p_kalman,
+                             int16_t p_accel_noise,
+                             int16_t p_measurement_noise,
+                             uint8_t p_gate
         ) {
     min_num_updates    = p_min_num_updates;
     track_lost_dt      = p_track_lost_dt;
     max_off_track      = (int32_t)p_max_off_track*p_max_off_track;
     max_start_distance = (int32_t)p_max_start_distance*p_max_start_distance;
-    alpha = p_alpha;
-    beta = p_beta;
-    saveTrackingFilterParams();
+    alpha = Fixed<int16_t, 15>::fromRaw(p_alpha);
+    beta = Fixed<int16_t, 12>::fromRaw(p_beta);
+    accel_noise = (int32_t)p_accel_noise*p_accel_noise;
+    measurement_noise = clip((int32_t)p_measurement_noise*p_measurement_noise, 1L,
+                             MAX_COVARIANCE);
+    gate = p_gate;
+    if(world_frame != p_world_frame || kalman != p_kalman) {
+        // the state is in the wrong frame or has no covariance, start over
+        last_update = micros() - track_lost_dt;
+    }
+    world_frame = p_world_frame;
+    kalman = p_kalman;
+    toParams(*this, &current_params);
 }
 
 void Track::saveTrackingFilterParams(void) {
     struct TrackingFilterParameters p;
-    p.alpha = alpha;
-    p.beta = beta;
-    p.min_num_updates = min_num_updates;
-    p.track_lost_dt = track_lost_dt;
-    p.max_off_track = max_off_track;
-    p.max_start_distance = max_start_distance;
+    toParams(*this, &p);
     eeprom_write_block(&p, &saved_tracking_params, sizeof(struct TrackingFilterParameters));
 }
 
 void Track::restoreTrackingFilterParams(void) {
-    struct TrackingFilterParameters p;
-    eeprom_read_block(&p, &saved_tracking_params, sizeof(struct TrackingFilterParameters));
-    alpha = p.alpha;
-    beta = p.beta;
-    min_num_updates = p.min_num_updates;
-    track_lost_dt = p.track_lost_dt;
-    max_off_track = p.max_off_track;
-    max_start_distance = p.max_start_distance;
+    eeprom_read_block(&current_params, &saved_tracking_params,
+                      sizeof(struct TrackingFilterParameters));
+    applyParams(*this, current_params);
+    if(num_updates == 0) {
+        // never seen a detection, lost under the restored interval too
+        last_update = micros() - track_lost_dt;
+    }
  }
@@ -2,39 +2,103 @@
 #include <stdint.h>
 #include "object.h"
 
+// Covariance of one axis of a constant velocity Kalman filter
+struct Covariance
+{
+    int32_t pp;  // position variance, mm^2
+    int32_t pv;  // position/velocity covariance, mm^2/s
+    int32_t vv;  // velocity variance, mm^2/s^2
+};
+
+// Innovation statistics of one track since they were last cleared, for
+// tuning the filter gains from telemetry. Innovations are in mm, the
+// normalized innovation squared is Q4 and against the Kalman innovation
+// covariance, or the detection noise alone for alpha-beta.
+struct InnovationStats
+{
+    uint8_t count;  // updates summed, stops at 255 so the sums fit
+    int32_t sum_rx, sum_ry;
+    uint32_t sum_rx2, sum_ry2;
+    uint32_t sum_nis;
+    uint16_t gate_rejections;  // frames a detection was gated out and none taken
+    uint16_t resets;  // restarts from a new detection
+
+    InnovationStats();
+    void add(int32_t rx, int32_t ry, int32_t nis);
+    void clear(void);
+};
+
+// Alpha-beta or constant velocity Kalman tracker. The velocity is the
+// target's own, our forward speed is taken out of the detections and put
+// back into every prediction. In the body frame the state is rotated by
+// the gyro on every predict. In the world frame objects
+// are rotated into an arena fixed frame by the integrated heading instead,
+// the filter runs there without a rotation term and only queries rotate
+// back to the body.
+//
+// The Kalman filter runs x and y as independent axes, each with its own
+// covariance, with white acceleration process noise scaled by the time
+// since the last predict. Its gains start high and settle as the track
+// ages, and detections are gated on the normalized innovation.
 struct Track
 {
-    int32_t x, vx, y, vy;
-    int32_t rx, ry;
+    Millimeters x, y;
+    MillimetersPerSec vx, vy;
+    Millimeters rx, ry;
     uint32_t num_updates;
     uint32_t last_update, last_predict;
-    int32_t last_omgaz;
+    Radians heading;  // integrated gyro heading, -pi to pi
+    MillimetersPerSec ego_vx;  // our forward speed, see getEgoVelocity
 
-    int16_t alpha, beta;  // position, velocity filter
+    Fixed<int16_t, 15> alpha;  // position filter
+    Fixed<int16_t, 12> beta;   // velocity filter, 1/s
     uint32_t track_lost_dt; // timeout for no observations
     uint32_t min_num_updates; // minimum number before trusted
     int32_t max_off_track; // squared distance in mm
     int32_t max_start_distance; // squared distance in mm
+    bool world_frame; // track in the world frame
 
+    bool kalman; // Kalman filter instead of alpha-beta
+    Covariance cx, cy;
+    int32_t accel_noise; // acceleration variance, mm^2/s^4
+    int32_t measurement_noise; // detection variance, mm^2
+    uint8_t gate; // maximum normalized innovation squared
+    InnovationStats innovations;
 
     // Default constructor
     Track();
-    void project(int32_t dt, int32_t dtheta, int32_t *px, int32_t *py) const;
-    int32_t predict(uint32_t now, int16_t omegaZ);
+    void project(int32_t dt, Radians dtheta, Millimeters *px, Millimeters *py) const;
+    void advance(int32_t dt, Radians dtheta);
+    int32_t predict(uint32_t now, Radians dtheta,
+                    MillimetersPerSec ego = MillimetersPerSec());
+    Track predictAt(uint32_t now,
+                    MillimetersPerSec ego = MillimetersPerSec()) const;
+    void relativeVelocity(MillimetersPerSec *pvx, MillimetersPerSec *pvy) const;
     void update(const Object& best_match);
+    void recordInnovation(void);
     int32_t distanceSq(const Object& obj) const;
+    bool gated(const Object& obj, int32_t distance) const;
     bool recent_update(uint32_t now) const;
     bool valid(uint32_t now) const;
-    int16_t updateOmegaZ(int32_t dt, int16_t omegaZ);
-    void updateNoObs(uint32_t inter_leddar_time, int16_t omegaZ);
+    void updateNoObs(uint32_t inter_leddar_time, Radians dtheta,
+                     MillimetersPerSec ego);
     bool wants_update(uint32_t now, int32_t best_distance);
-    int32_t angle(void) const;
-    int32_t vtheta(void) const;
+    Radians angle(void) const;
+    RadiansPerSec vtheta(void) const;
+    void bodyPosition(Millimeters *px, Millimeters *py) const;
+    void bodyVelocity(MillimetersPerSec *pvx, MillimetersPerSec *pvy) const;
+    void lookahead(int32_t dt, RadiansPerSec omegaZ,
+                   Millimeters *px, Millimeters *py) const;
     void setTrackingFilterParams(int16_t alpha, int16_t beta,
                              int8_t p_min_num_updates,
                              uint32_t p_track_lost_dt,
                              int16_t p_max_off_track,
-                             int16_t p_max_start_distance);
+                             int16_t p_max_start_distance,
+                             bool p_world_frame,
+                             bool p_kalman,
+                             int16_t p_accel_noise,
+                             int16_t p_measurement_noise,
+                             uint8_t p_gate);
     void saveTrackingFilterParams(void);
     void restoreTrackingFilterParams(void);
 };
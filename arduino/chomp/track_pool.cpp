@@ -0,0 +1,197 @@
+#include <Arduino.h>
+#include "track_pool.h"
+#include "utils.h"
+#include "gyro_history.h"
+
+// primaryTrack() when there is no primary, never updated so never valid
+static const Track no_track;
+
+TrackPool::TrackPool() : primary(-1) { }
+
+// squared distance from the robot in mm, the same in either frame
+static int32_t rangeSq(const Track &track) {
+    int32_t x = clip(track.x.toInt(), -32767L, 32767L);
+    int32_t y = clip(track.y.toInt(), -32767L, 32767L);
+    return x*x + y*y;
+}
+
+// nearest track to the robot, valid ones only or any live one
+static int8_t nearestTrack(const Track (&tracks)[MAX_TRACKS], uint32_t now,
+                           bool valid_only) {
+    int8_t best = -1;
+    int32_t best_range = 0;
+    for(int8_t t = 0; t < MAX_TRACKS; t++) {
+        bool candidate = valid_only ? tracks[t].valid(now) :
+                                      tracks[t].recent_update(now);
+        if(!candidate) {
+            continue;
+        }
+        int32_t range = rangeSq(tracks[t]);
+        if(best < 0 || range < best_range) {
+            best = t;
+            best_range = range;
+        }
+    }
+    return best;
+}
+
+// measured body rotation since the track was last predicted
+static Radians rotationSince(const Track &track, uint32_t now) {
+    return Radians::saturated(gyroRotation(track.last_predict, now));
+}
+
+// Returns the object assigned to the primary track, -1 for none.
+//
+// Assignment is greedy global nearest neighbour: the closest gated
+// track/detection pair anywhere in the frame is taken first, then the
+// closest of what is left and so on. Each distance is computed once into a
+// MAX_TRACKS x 8 table, so the worst case is 32 distanceSq calls and 4
+// passes over the table, well inside the LEDDAR frame.
+int8_t TrackPool::update(uint32_t now, const Object (&objects)[8],
+                         uint8_t num_objects, MillimetersPerSec ego,
+                         bool closest_only) {
+    int8_t assigned[MAX_TRACKS];
+    for(int8_t t = 0; t < MAX_TRACKS; t++) {
+        assigned[t] = -1;
+    }
+
+    if(num_objects == 0) {
+        for(int8_t t = 0; t < MAX_TRACKS; t++) {
+            tracks[t].updateNoObs(now, rotationSince(tracks[t], now), ego);
+        }
+    } else {
+        // gate, -1 marks pairs outside the track's gate or dead tracks
+        int32_t cost[MAX_TRACKS][8];
+        for(int8_t t = 0; t < MAX_TRACKS; t++) {
+            tracks[t].predict(now, rotationSince(tracks[t], now), ego);
+            bool live = tracks[t].recent_update(now);
+            for(uint8_t o = 0; o < num_objects; o++) {
+                int32_t distance = live ? tracks[t].distanceSq(objects[o]) : -1;
+                if(distance >= 0 && !tracks[t].gated(objects[o], distance)) {
+                    distance = -1;
+                }
+                cost[t][o] = distance;
+            }
+        }
+
+        uint8_t used_objects = 0;
+        uint8_t used_tracks = 0;
+        while(true) {
+            int8_t best_track = -1;
+            uint8_t best_object = 0;
+            int32_t best_cost = 0;
+            for(int8_t t = 0; t < MAX_TRACKS; t++) {
+                if(used_tracks & (1 << t)) {
+                    continue;
+                }
+                for(uint8_t o = 0; o < num_objects; o++) {
+                    int32_t c = cost[t][o];
+                    if(c >= 0 && !(used_objects & (1 << o)) &&
+                       (best_track < 0 || c < best_cost)) {
+                        best_track = t;
+                        best_object = o;
+                        best_cost = c;
+                    }
+                }
+            }
+            if(best_track < 0) {
+                break;
+            }
+            tracks[best_track].update(objects[best_object]);
+            assigned[best_track] = best_object;
+            used_tracks |= (1 << best_track);
+            used_objects |= (1 << best_object);
+        }
+
+        // live tracks that saw detections but took none of them
+        for(int8_t t = 0; t < MAX_TRACKS; t++) {
+            if(!(used_tracks & (1 << t)) && tracks[t].recent_update(now)) {
+                tracks[t].innovations.gate_rejections++;
+            }
+        }
+
+        // births, nearest unclaimed detection first into dead slots
+        for(int8_t t = 0; t < MAX_TRACKS; t++) {
+            if(tracks[t].recent_update(now)) {
+                continue;
+            }
+            int8_t best_object = -1;
+            int32_t best_distance = 0;
+            for(uint8_t o = 0; o < num_objects; o++) {
+                if(used_objects & (1 << o)) {
+                    continue;
+                }
+                int32_t distance = objects[o].Radius;
+                distance *= distance;
+                if(best_object < 0 || distance < best_distance) {
+                    best_object = o;
+                    best_distance = distance;
+                }
+            }
+            if(best_object < 0 ||
+               !tracks[t].wants_update(now, best_distance)) {
+                break;
+            }
+            tracks[t].update(objects[best_object]);
+            assigned[t] = best_object;
+            used_objects |= (1 << best_object);
+        }
+    }
+
+    // Keep the primary while it is valid so a nearer piece of clutter does
+    // not steal the hammer, unless only the closest target matters. When it
+    // is lost take the nearest valid track, then the nearest tentative one.
+    if(closest_only || primary < 0 || !tracks[primary].valid(now)) {
+        primary = nearestTrack(tracks, now, true);
+        if(primary < 0) {
+            primary = nearestTrack(tracks, now, false);
+        }
+    }
+    return primary < 0 ? -1 : assigned[primary];
+}
+
+const Track &TrackPool::primaryTrack(void) const {
+    return primary < 0 ? no_track : tracks[primary];
+}
+
+uint8_t TrackPool::numValid(uint32_t now) const {
+    uint8_t n = 0;
+    for(int8_t t = 0; t < MAX_TRACKS; t++) {
+        if(tracks[t].valid(now)) {
+            n++;
+        }
+    }
+    return n;
+}
+
+void TrackPool::clearInnovations(void) {
+    for(int8_t t = 0; t < MAX_TRACKS; t++) {
+        tracks[t].innovations.clear();
+    }
+}
+
+void TrackPool::setTrackingFilterParams(int16_t alpha, int16_t beta,
+                                        int8_t p_min_num_updates,
+                                        uint32_t p_track_lost_dt,
+                                        int16_t p_max_off_track,
+                                        int16_t p_max_start_distance,
+                                        bool p_world_frame,
+                                        bool p_kalman,
+                                        int16_t p_accel_noise,
+                                        int16_t p_measurement_noise,
+                                        uint8_t p_gate) {
+    for(int8_t t = 0; t < MAX_TRACKS; t++) {
+        tracks[t].setTrackingFilterParams(alpha, beta, p_min_num_updates,
+                                          p_track_lost_dt, p_max_off_track,
+                                          p_max_start_distance, p_world_frame,
+                                          p_kalman, p_accel_noise,
+                                          p_measurement_noise, p_gate);
+    }
+    tracks[0].saveTrackingFilterParams();
+}
+
+void TrackPool::restoreTrackingFilterParams(void) {
+    for(int8_t t = 0; t < MAX_TRACKS; t++) {
+        tracks[t].restoreTrackingFilterParams();
+    }
+}
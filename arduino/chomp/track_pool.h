@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+#include "object.h"
+#include "track.h"
+
+#define MAX_TRACKS 4
+
+// Fixed set of tracks, so a second robot or a piece of debris gets its own
+// track instead of pulling the opponent's filter off. Each frame detections
+// go to live tracks nearest pair first inside each track's gate, the
+// detections left over start tracks in free slots and a track dies after
+// track_lost_dt without a detection. One track is primary, the one
+// steering and autofire act on.
+struct TrackPool
+{
+    Track tracks[MAX_TRACKS];
+    int8_t primary;  // index into tracks, -1 for none
+
+    TrackPool();
+    int8_t update(uint32_t now, const Object (&objects)[8],
+                  uint8_t num_objects, MillimetersPerSec ego,
+                  bool closest_only);
+    const Track &primaryTrack(void) const;
+    uint8_t numValid(uint32_t now) const;
+    void clearInnovations(void);
+    void setTrackingFilterParams(int16_t alpha, int16_t beta,
+                                 int8_t p_min_num_updates,
+                                 uint32_t p_track_lost_dt,
+                                 int16_t p_max_off_track,
+                                 int16_t p_max_start_distance,
+                                 bool p_world_frame,
+                                 bool p_kalman,
+                                 int16_t p_accel_noise,
+                                 int16_t p_measurement_noise,
+                                 uint8_t p_gate);
+    void restoreTrackingFilterParams(void);
+};
@@ -0,0 +1,167 @@
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <util/atomic.h>
+#include "valve_timer.h"
+#include "pins.h"
+#include "fast_pins.h"
+
+static void saveValveTimingParameters(void);
+
+struct ValveTimingParams {
+    uint16_t throw_latency;
+    uint16_t vent_latency;
+    uint8_t predict;
+    uint16_t vent_lead;
+    uint8_t pre_arm;
+};
+
+static struct ValveTimingParams EEMEM saved_params = {
+    .throw_latency = 0,
+    .vent_latency = 0,
+    .predict = 1,
+    .vent_lead = 10000,
+    .pre_arm = 1,
+};
+
+static struct ValveTimingParams params;
+
+// Timer3 counts at 16MHz/64, 4us a tick, so the 16 bit compare reaches 262ms
+#define VALVE_TICK_US 4
+#define VALVE_MAX_TICKS 65535UL
+
+static volatile bool throw_closed = false;
+static volatile bool vent_opened = false;
+static volatile uint32_t throw_closed_time;
+static volatile uint32_t vent_opened_time;
+
+static void closeThrow(void) {
+    fastDigitalWrite<THROW_VALVE_DO>(LOW);
+    throw_closed_time = micros();
+    throw_closed = true;
+}
+
+static void openVent(void) {
+    fastDigitalWrite<VENT_VALVE_DO>(LOW);
+    vent_opened_time = micros();
+    vent_opened = true;
+}
+
+ISR(TIMER3_COMPA_vect) {
+    TIMSK3 &= ~(1 << OCIE3A);
+    closeThrow();
+}
+
+ISR(TIMER3_COMPB_vect) {
+    TIMSK3 &= ~(1 << OCIE3B);
+    openVent();
+}
+
+void valveTimerInit(void) {
+    // normal mode at clk/64, pins 2, 3 and 5 are not used for PWM output
+    TCCR3A = 0;
+    TCCR3B = (1 << CS31) | (1 << CS30);
+    TIMSK3 = 0;
+}
+
+// ticks from now to at, 0 when it has passed
+static uint32_t ticksUntil(uint32_t at) {
+    int32_t delay = at - micros();
+    return delay <= 0 ? 0 : delay / VALVE_TICK_US;
+}
+
+void scheduleThrowClose(uint32_t at) {
+    uint32_t ticks = ticksUntil(at);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        TIMSK3 &= ~(1 << OCIE3A);
+        if(!throw_closed && ticks <= VALVE_MAX_TICKS) {
+            // too close to catch the compare, it is now
+            if(ticks < 2) {
+                closeThrow();
+            } else {
+                OCR3A = TCNT3 + (uint16_t)ticks;
+                TIFR3 = (1 << OCF3A);
+                TIMSK3 |= (1 << OCIE3A);
+            }
+        }
+    }
+}
+
+void scheduleVentOpen(uint32_t at) {
+    uint32_t ticks = ticksUntil(at);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        TIMSK3 &= ~(1 << OCIE3B);
+        if(!vent_opened && ticks <= VALVE_MAX_TICKS) {
+            if(ticks < 2) {
+                openVent();
+            } else {
+                OCR3B = TCNT3 + (uint16_t)ticks;
+                TIFR3 = (1 << OCF3B);
+                TIMSK3 |= (1 << OCIE3B);
+            }
+        }
+    }
+}
+
+void cancelValveTimers(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        TIMSK3 &= ~((1 << OCIE3A) | (1 << OCIE3B));
+        throw_closed = false;
+        vent_opened = false;
+    }
+}
+
+bool throwClosedAt(uint32_t *time) {
+    bool closed;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        closed = throw_closed;
+        *time = throw_closed_time;
+    }
+    return closed;
+}
+
+bool ventOpenedAt(uint32_t *time) {
+    bool opened;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        opened = vent_opened;
+        *time = vent_opened_time;
+    }
+    return opened;
+}
+
+void setValveTimingParameters(uint16_t throw_latency, uint16_t vent_latency,
+                              bool predict, uint16_t vent_lead, bool pre_arm) {
+    params.throw_latency = throw_latency;
+    params.vent_latency = vent_latency;
+    params.predict = predict;
+    params.vent_lead = vent_lead;
+    params.pre_arm = pre_arm;
+    saveValveTimingParameters();
+}
+
+uint16_t getThrowLatency(void) {
+    return params.throw_latency;
+}
+
+uint16_t getVentLatency(void) {
+    return params.vent_latency;
+}
+
+bool valvePredictionEnabled(void) {
+    return params.predict;
+}
+
+uint16_t getVentLead(void) {
+    return params.vent_lead;
+}
+
+bool preArmEnabled(void) {
+    return params.pre_arm;
+}
+
+static void saveValveTimingParameters(void) {
+    eeprom_write_block(&params, &saved_params, sizeof(struct ValveTimingParams));
+}
+
+void restoreValveTimingParameters(void) {
+    eeprom_read_block(&params, &saved_params, sizeof(struct ValveTimingParams));
+}
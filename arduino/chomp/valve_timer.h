@@ -0,0 +1,32 @@
+#pragma once
+#include <stdint.h>
+
+// Throw valve close and vent open on Timer3 compare A and B, so a swing's
+// valve transitions land at the instant predicted from the angle samples
+// rather than on the next 2ms poll. Both transitions are to the safe
+// state, so the interrupts write the pins directly.
+void valveTimerInit(void);
+// act at the micros() time at, now if that has passed or is too close to
+// catch. Further than 262ms ahead nothing is armed, a later call with a
+// nearer time does it. Each call replaces the last.
+void scheduleThrowClose(uint32_t at);
+void scheduleVentOpen(uint32_t at);
+void cancelValveTimers(void);
+// micros() when the timer acted on the valve, false while it has not
+bool throwClosedAt(uint32_t *time);
+bool ventOpenedAt(uint32_t *time);
+
+// Valve actuation latencies in microseconds, the time from the pin
+// changing to the valve acting, taken off the predicted crossing. With
+// predict off the swing loop closes the valves from its own polls.
+// vent_lead is how long the vent is sealed before the throw valve opens,
+// pre_arm lets autofire seal it, with the hold down and flame, before the
+// strike instant.
+void setValveTimingParameters(uint16_t throw_latency, uint16_t vent_latency,
+                              bool predict, uint16_t vent_lead, bool pre_arm);
+void restoreValveTimingParameters(void);
+uint16_t getThrowLatency(void);
+uint16_t getVentLatency(void);
+bool valvePredictionEnabled(void);
+uint16_t getVentLead(void);
+bool preArmEnabled(void);
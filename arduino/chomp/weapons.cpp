@@ -3,11 +3,19 @@
 #include "rc_pwm.h"
 #include "sensors.h"
 #include "pins.h"
+#include "fast_pins.h"
 #include "utils.h"
 #include "telem.h"
 #include "selfright.h"
 #include <avr/wdt.h>
 #include "hold_down.h"
+#include "autofire.h"
+#include "valve_timer.h"
+#include "swing_capture.h"
+#include "swing_recorder.h"
+#include "hammer_velocity.h"
+#include "retract_profile.h"
+#include "swing_crossing.h"
 
 extern HardwareSerial& DriveSerial;
 
@@ -26,7 +34,8 @@ bool weaponsEnabled(){
 static bool hammer_in_motion = false;
 
 // HAMMER DATA BUFFERS
-#define MAX_DATAPOINTS 500
+// sixteen swing telemetry packets of 32 points
+#define MAX_DATAPOINTS 512
 static uint16_t angle_data[MAX_DATAPOINTS];
 static int16_t pressure_data[MAX_DATAPOINTS];
 
@@ -42,52 +51,53 @@ static const uint16_t THROW_COMPLETE_ANGLE = RELATIVE_TO_FORWARD;
 
 void retract( bool check_velocity ){
     uint16_t angle;
-    uint32_t sensor_read_time;
-    uint32_t delay_time;
+    uint32_t command_time;
     uint32_t retract_time;
 
     bool velocity_ok = true;
     if (check_velocity){
-      float angular_velocity;
-      bool velocity_read_ok = angularVelocity(&angular_velocity);
+      int16_t angular_velocity;
+      bool velocity_read_ok = hammerVelocity(&angular_velocity);
       velocity_ok = velocity_read_ok && abs(angular_velocity) < RETRACT_BEGIN_VEL_MAX;
     }
 
     bool angle_read_ok = readAngle(&angle);
     // Only retract if hammer is forward and not moving
     if (weaponsEnabled() && angle_read_ok && angle > RETRACT_COMPLETE_ANGLE && velocity_ok) {
+        retractStarted(check_velocity ? RETRACT_MANUAL : RETRACT_AUTO, angle);
         retract_time = micros();
-        String movecmd = startElectricHammerMove(1000);
+        startElectricHammerMove(retractCommand(angle, RETRACT_COMPLETE_ANGLE));
+        command_time = micros();
         while (micros() - retract_time < RETRACT_TIMEOUT && angle > RETRACT_COMPLETE_ANGLE) {
             // process sbus data and check if weaponsEnabled has changed state
             sbusGood();
-            sensor_read_time = micros();
+            // one angle read and one command each period, evenly spaced
+            // samples for the velocity fit and a steady stream to the motor
+            while (micros() - command_time < getRetractPeriod());
+            command_time += getRetractPeriod();
             readAngle(&angle);
-            // Ensure that loop step takes 1 ms or more (without this it takes quite a bit less)
-            sensor_read_time = micros() - sensor_read_time;
-            delay_time = 10000 - sensor_read_time;
-            if (delay_time > 0) {
-                delayMicroseconds(delay_time);
-            }
-            DriveSerial.println(movecmd);
+            electricHammerSpeed(retractCommand(angle, RETRACT_COMPLETE_ANGLE));
         }
         stopElectricHammerMove();
+        retractFinished(angle, angle <= RETRACT_COMPLETE_ANGLE);
     }
 }
 
 // Helper to end a swing in case of timeout or hammer obstruction (zero velocity)
 void endSwing( bool& throw_open, bool& vent_closed, uint16_t& throw_close_timestep, uint16_t& vent_open_timestep, uint16_t timestep,
               bool auto_hold_down){
+  swingCaptureStop();
+  cancelValveTimers();
   if (throw_open) {
     throw_close_timestep = timestep;
   }
-  safeDigitalWrite(THROW_VALVE_DO, LOW);
+  safeFastDigitalWrite<THROW_VALVE_DO>(LOW);
   throw_open = false;
   delay(10);
   if (vent_closed) {
     vent_open_timestep = timestep;
   }
-  safeDigitalWrite(VENT_VALVE_DO, LOW);
+  safeFastDigitalWrite<VENT_VALVE_DO>(LOW);
   vent_closed = false;
   // Stop hold down and If we have been accumulatting hold down
   // traces, send them
@@ -97,14 +107,129 @@ void endSwing( bool& throw_open, bool& vent_closed, uint16_t& throw_close_timest
   }
 }
 
+// PRE-ARM
+// While autofire expects a strike the vent is sealed and the hold down and
+// flame started ahead of the strike instant, so fire() only waits out what
+// is left of the vent lead. A prediction that does not turn into a swing
+// within PRE_ARM_TIMEOUT is dropped, and once dropped pre-arm waits as long
+// again before sealing the vent again.
+#define PRE_ARM_TIMEOUT 250000UL
+static bool pre_armed = false;
+static bool pre_arm_flame;
+static bool pre_arm_hold;
+static uint32_t pre_arm_time;  // when the vent was sealed
+
+static void preArmCancel(void) {
+    if (!pre_armed) {
+        return;
+    }
+    safeFastDigitalWrite<VENT_VALVE_DO>(LOW);
+    if (pre_arm_flame) {
+        flameEnd();
+    }
+    if (pre_arm_hold) {
+        autoHoldDownEnd();
+    }
+    pre_armed = false;
+}
+
+void preArm(bool strike_expected, bool flame_pulse, bool auto_hold_down) {
+    uint32_t now = micros();
+    if (pre_armed) {
+        if (!strike_expected || !weaponsEnabled() ||
+            now - pre_arm_time > PRE_ARM_TIMEOUT) {
+            preArmCancel();
+            pre_arm_time = now;
+        } else if (pre_arm_hold) {
+            // keep sampling the vacuum
+            autoHoldDown(pre_arm_time, now);
+        }
+        return;
+    }
+    if (!strike_expected || !preArmEnabled() || !weaponsEnabled() ||
+        hammer_in_motion || now - pre_arm_time < PRE_ARM_TIMEOUT) {
+        return;
+    }
+    uint16_t angle = getAngle();
+    if (angle <= THROW_BEGIN_ANGLE_MIN || angle >= THROW_BEGIN_ANGLE_MAX) {
+        return;
+    }
+    safeFastDigitalWrite<VENT_VALVE_DO>(HIGH);
+    if (flame_pulse) {
+        flameStart();
+    }
+    if (auto_hold_down) {
+        autoHoldDown(now, now);
+    }
+    pre_armed = true;
+    pre_arm_flame = flame_pulse;
+    pre_arm_hold = auto_hold_down;
+    pre_arm_time = now;
+}
+
+uint32_t throwValveDelay(uint32_t now, bool auto_hold_down) {
+    // relative to now, pre-arm started the vent and maybe the hold down
+    // clocks at pre_arm_time, fire() starts the rest when it runs
+    int32_t armed_at = pre_armed ? -(int32_t)(now - pre_arm_time) : 0;
+    int32_t hold_end = 0;
+    if (pre_armed && pre_arm_hold) {
+        hold_end = armed_at + getAutoholdStartDelay();
+    } else if (auto_hold_down) {
+        hold_end = getAutoholdStartDelay();
+    }
+    // unarmed the vent is sealed once the hold down wait is over
+    int32_t vent_end = (pre_armed ? armed_at : hold_end) + getVentLead();
+    int32_t delay = max(hold_end, vent_end);
+    return delay > 0 ? delay : 0;
+}
+
+// LIVE SWING TELEMETRY
+// The last trace goes out a packet at a time from the main loop, copied
+// through the UART buffer, so the trace buffers are never on loan to the
+// link. The next swing takes them back and drops whatever is left to send,
+// the recorder still has that swing in full.
+#define SWING_TELEM_PERIOD 50000UL
+static struct SwingTelemSend {
+    bool active;
+    uint16_t datapoints;
+    uint16_t first;        // next point to send
+    uint16_t sample_period;
+    uint16_t throw_close;
+    uint16_t vent_open;
+    uint16_t throw_close_angle;
+    uint16_t start_angle;
+    uint32_t trigger_latency;
+    uint32_t vent_lead;
+    uint32_t last_time;
+} swing_telem;
+
+void swingTelemStep(uint32_t now) {
+    if (!swing_telem.active || now - swing_telem.last_time < SWING_TELEM_PERIOD) {
+        return;
+    }
+    swing_telem.last_time = now;
+    uint16_t first = swing_telem.first;
+    sendSwingTelem(swing_telem.datapoints, first,
+                   angle_data + first, pressure_data + first,
+                   swing_telem.sample_period, swing_telem.throw_close,
+                   swing_telem.vent_open, swing_telem.throw_close_angle,
+                   swing_telem.start_angle, swing_telem.trigger_latency,
+                   swing_telem.vent_lead);
+    swing_telem.first += SWING_TELEM_POINTS;
+    if (swing_telem.first >= swing_telem.datapoints) {
+        swing_telem.active = false;
+    }
+}
+
 void fire( uint16_t hammer_intensity, bool flame_pulse, bool autofire, bool auto_hold_down ){
+    uint32_t trigger_time = micros();
     uint32_t fire_time;
+    uint32_t vent_sealed;
     uint32_t swing_length = 0;
     uint32_t sensor_read_time;
     uint16_t throw_close_timestep = 0;
     uint16_t vent_open_timestep = 0;
     uint16_t datapoints_collected = 0;
-    uint16_t timestep = 0;
     bool vent_closed = false;
     bool throw_open = false;
     uint32_t delay_time;
@@ -112,6 +237,12 @@ void fire( uint16_t hammer_intensity, bool flame_pulse, bool autofire, bool auto
     uint16_t start_angle;
     int16_t pressure;
     bool pressure_read_ok;
+    AngleSamples samples;
+    samples.count = 0;
+    // with interrupt capture the trace runs at its own rate, the loop
+    // still polls every DATA_COLLECT_TIMESTEP for the valves
+    uint16_t capture_period = getSwingCapturePeriod();
+    uint16_t sample_period = capture_period ? capture_period : DATA_COLLECT_TIMESTEP;
 
     bool angle_read_ok = readAngle(&angle);
     if (weaponsEnabled() && angle_read_ok && !hammer_in_motion){
@@ -121,61 +252,108 @@ void fire( uint16_t hammer_intensity, bool flame_pulse, bool autofire, bool auto
         uint16_t throw_close_angle_diff = min(MAX_SAFE_ANGLE, HAMMER_INTENSITIES_ANGLE[hammer_intensity]);
         uint16_t throw_close_angle = start_angle + throw_close_angle_diff;
         if (angle > THROW_BEGIN_ANGLE_MIN && angle < THROW_BEGIN_ANGLE_MAX) {
- 
-            if (flame_pulse){
+            // the buffers are this swing's now, the recorder has the last
+            swing_telem.active = false;
+            // the swing takes over what pre-arm started and ends it
+            bool armed = pre_armed;
+            pre_armed = false;
+            flame_pulse |= armed && pre_arm_flame;
+            auto_hold_down |= armed && pre_arm_hold;
+
+            if (flame_pulse && !(armed && pre_arm_flame)){
                 flameStart();
             }
 
-            uint32_t autohold_start = micros();
-            uint32_t now = autohold_start;
+            uint32_t autohold_start = armed && pre_arm_hold ? pre_arm_time : micros();
+            uint32_t now = micros();
             while(auto_hold_down && !autoHoldDown(autohold_start, now))
             {
                 now = micros();
             }
 
             // Seal vent (which is normally open)
-            safeDigitalWrite(VENT_VALVE_DO, HIGH);
+            vent_sealed = armed ? pre_arm_time : micros();
+            safeFastDigitalWrite<VENT_VALVE_DO>(HIGH);
             vent_closed = true;
-            // can we actually determine vent close time?
-            delay(10);
+            while (micros() - vent_sealed < getVentLead());
 
             // Open throw valve
-            safeDigitalWrite(THROW_VALVE_DO, HIGH);
+            cancelValveTimers();
+            if (capture_period) {
+                swingCaptureStart();
+            }
+            safeFastDigitalWrite<THROW_VALVE_DO>(HIGH);
             throw_open = true;
             fire_time = micros();
             // Wait until hammer swing complete, up to timeout
             while (swing_length < SWING_TIMEOUT) {
                 sensor_read_time = micros();
-                angle_read_ok = readAngle(&angle);
-                pressure_read_ok = readMlhPressure(&pressure);
-
-                if (throw_open && angle > throw_close_angle) {
-                    throw_close_timestep = timestep;
-                    safeDigitalWrite(THROW_VALVE_DO, LOW);
-                    throw_open = false;
+                if (capture_period) {
+                    uint32_t sample_time;
+                    angle_read_ok = swingCaptureLatest(&angle, &pressure, &sample_time);
+                    if (angle_read_ok) {
+                        addAngleSample(samples, sample_time, angle);
+                        hammerVelocitySample(sample_time, angle);
+                    } else {
+                        hammerVelocityReset();
+                    }
+                    datapoints_collected = swingCaptureDrain(angle_data, pressure_data,
+                                                             datapoints_collected, MAX_DATAPOINTS);
+                } else {
+                    angle_read_ok = readAngle(&angle);
+                    pressure_read_ok = readMlhPressure(&pressure);
+                    if (angle_read_ok) {
+                        addAngleSample(samples, sensor_read_time, angle);
+                    }
+                    if (datapoints_collected < MAX_DATAPOINTS){
+                        angle_data[datapoints_collected] = angle;
+                        if(pressure_read_ok) {
+                            pressure_data[datapoints_collected] = pressure;
+                        } else {
+                            pressure_data[datapoints_collected] = -1;
+                        }
+                        datapoints_collected++;
+                    }
                 }
-                if (vent_closed && angle > VENT_OPEN_ANGLE) {
-                    vent_open_timestep = timestep;
-                    safeDigitalWrite(VENT_VALVE_DO, LOW);
-                    vent_closed = false;
+                // Close the throw valve at the predicted crossing less the
+                // valve latency, or now if the hammer is already past it.
+                // Each poll refines the time with the newest samples.
+                uint32_t crossing;
+                uint32_t valve_time;
+                if (throw_open) {
+                    if (angle > throw_close_angle) {
+                        scheduleThrowClose(micros());
+                    } else if (valvePredictionEnabled() &&
+                               predictCrossing(samples, throw_close_angle, &crossing)) {
+                        scheduleThrowClose(crossing - getThrowLatency());
+                    }
+                    if (throwClosedAt(&valve_time)) {
+                        throw_close_timestep = (valve_time - fire_time) / sample_period;
+                        throw_open = false;
+                    }
                 }
-                if (datapoints_collected < MAX_DATAPOINTS){
-                    angle_data[datapoints_collected] = angle;
-                    if(pressure_read_ok) {
-                        pressure_data[datapoints_collected] = pressure;
-                    } else {
-                        pressure_data[datapoints_collected] = -1;
+                // The vent the same way, once the throw valve is shut
+                if (vent_closed && !throw_open) {
+                    if (angle > VENT_OPEN_ANGLE) {
+                        scheduleVentOpen(micros());
+                    } else if (valvePredictionEnabled() &&
+                               predictCrossing(samples, VENT_OPEN_ANGLE, &crossing)) {
+                        scheduleVentOpen(crossing - getVentLatency());
+                    }
+                    if (ventOpenedAt(&valve_time)) {
+                        vent_open_timestep = (valve_time - fire_time) / sample_period;
+                        vent_closed = false;
                     }
-                    datapoints_collected++;
                 }
 
                 // Once past our throw close angle, start checking velocity 
                 if (angle > AUTO_RETRACT_MIN_ANGLE) {
-                    float angular_velocity;
-                    bool velocity_read_ok = angularVelocityBuffered(&angular_velocity, angle_data, datapoints_collected, DATA_COLLECT_TIMESTEP/1000);
+                    int16_t angular_velocity;
+                    bool velocity_read_ok = hammerVelocity(&angular_velocity);
                     if (velocity_read_ok && abs(angular_velocity) < RETRACT_BEGIN_VEL_MAX) {
                         // If the swing hasn't already ended, end it now
-                        endSwing(throw_open, vent_closed, throw_close_timestep, vent_open_timestep, timestep, auto_hold_down);
+                        endSwing(throw_open, vent_closed, throw_close_timestep, vent_open_timestep,
+                                 (micros() - fire_time) / sample_period, auto_hold_down);
                         // Since our final velocity is low enough, auto-retract
                         retract( /*check_velocity*/ false );
                         break; // exit the while loop
@@ -188,32 +366,63 @@ void fire( uint16_t hammer_intensity, bool flame_pulse, bool autofire, bool auto
                 if (delay_time > 0) {
                     delayMicroseconds(delay_time);
                 }
-                timestep++;
                 swing_length = micros() - fire_time;
             } // while
             // If the swing hasn't already ended, end it now
-            endSwing(throw_open, vent_closed, throw_close_timestep, vent_open_timestep, timestep, auto_hold_down);
+            endSwing(throw_open, vent_closed, throw_close_timestep, vent_open_timestep,
+                     (micros() - fire_time) / sample_period, auto_hold_down);
+            if (capture_period) {
+                datapoints_collected = swingCaptureDrain(angle_data, pressure_data,
+                                                         datapoints_collected, MAX_DATAPOINTS);
+            }
 
             if (flame_pulse) {
                 flameEnd();
             }
+
+            // learn how long this intensity takes to reach the strike from
+            // the throw valve opening, where the trace starts, the same
+            // whether or not pre-arm ran the waits before it
+            int32_t strike = traceStrikeTime(angle_data, datapoints_collected,
+                                             sample_period,
+                                             THROW_COMPLETE_ANGLE);
+            if (strike >= 0 && learnSwingDuration(hammer_intensity, strike)) {
+                sendSwingDurations();
+            }
+            recordSwing(angle_data, pressure_data, datapoints_collected,
+                        sample_period, throw_close_timestep,
+                        vent_open_timestep, start_angle,
+                        hammer_intensity, autofire);
         } else if (!autofire) {
             // If we're *not* in autochomp mode, and the hammer is at a funny angle, it probably
             // means we're in a weird spot and maybe want to unstick ourselves with a
             // minimum-intensity danger fire.
+            preArmCancel();
             noAngleFire(/* hammer intensity */1, false);
             return;
         }
 
-        sendSwingTelem(datapoints_collected,
-                      angle_data,
-                      pressure_data,
-                      DATA_COLLECT_TIMESTEP,
-                      throw_close_timestep,
-                      vent_open_timestep,
-                      throw_close_angle,
-                      start_angle);
+        // keep every decimation'th point, in place since the trace is done
+        uint8_t decimation = getSwingTelemetryDecimation();
+        uint16_t telemetry_points = 0;
+        for (uint16_t i = 0; i < datapoints_collected; i += decimation) {
+            angle_data[telemetry_points] = angle_data[i];
+            pressure_data[telemetry_points] = pressure_data[i];
+            telemetry_points++;
+        }
+        swing_telem.datapoints = telemetry_points;
+        swing_telem.first = 0;
+        swing_telem.sample_period = sample_period * decimation;
+        swing_telem.throw_close = throw_close_timestep / decimation;
+        swing_telem.vent_open = vent_open_timestep / decimation;
+        swing_telem.throw_close_angle = throw_close_angle;
+        swing_telem.start_angle = start_angle;
+        swing_telem.trigger_latency = fire_time - trigger_time;
+        swing_telem.vent_lead = fire_time - vent_sealed;
+        swing_telem.active = true;
     }
+    // a pre-arm the swing did not take over
+    preArmCancel();
 }
 
 const uint8_t NO_ANGLE_SWING_DURATION = 185; // total estimated time in ms of a swing (to calculate vent time)
@@ -224,18 +433,18 @@ void noAngleFire( uint16_t hammer_intensity, bool flame_pulse){
         }
         uint8_t throw_duration = min(MAX_SAFE_TIME, HAMMER_INTENSITIES_TIME[hammer_intensity]);
         // Seal vent valve
-        safeDigitalWrite(VENT_VALVE_DO, HIGH);
-        // can we actually determine vent close time?
-        delay(10);
+        uint32_t vent_sealed = micros();
+        safeFastDigitalWrite<VENT_VALVE_DO>(HIGH);
+        while (micros() - vent_sealed < getVentLead());
         
         // Open throw valve
-        safeDigitalWrite(THROW_VALVE_DO, HIGH);
+        safeFastDigitalWrite<THROW_VALVE_DO>(HIGH);
         delay(throw_duration);
-        safeDigitalWrite(THROW_VALVE_DO, LOW);
+        safeFastDigitalWrite<THROW_VALVE_DO>(LOW);
 
         // Wait the estimated remaining time in the swing and then vent
         delay(NO_ANGLE_SWING_DURATION - throw_duration);
-        safeDigitalWrite(VENT_VALVE_DO, LOW);
+        safeFastDigitalWrite<VENT_VALVE_DO>(LOW);
 
         if (flame_pulse) {
             flameEnd();
@@ -249,9 +458,9 @@ void noAngleFire( uint16_t hammer_intensity, bool flame_pulse){
 String startElectricHammerMove(int16_t speed) {
     hammer_in_motion = true;
     // Make sure we're vented
-    safeDigitalWrite(VENT_VALVE_DO, LOW);
+    safeFastDigitalWrite<VENT_VALVE_DO>(LOW);
     // engage drive wheel
-    safeDigitalWrite(RETRACT_VALVE_DO, HIGH);
+    safeFastDigitalWrite<RETRACT_VALVE_DO>(HIGH);
     // wait for engagement
     delay(50);
     String movecmd("@05!G ");
@@ -260,9 +469,14 @@ String startElectricHammerMove(int16_t speed) {
     return movecmd;
 }
 
+void electricHammerSpeed(int16_t speed) {
+    DriveSerial.print("@05!G ");
+    DriveSerial.println(speed);
+}
+
 void stopElectricHammerMove(void) {
     // disengage even if weapons are disabled
-    digitalWrite(RETRACT_VALVE_DO, LOW);
+    fastDigitalWrite<RETRACT_VALVE_DO>(LOW);
     DriveSerial.println("@05!G 0");
     // wait for disengage
     delay(50);
@@ -301,20 +515,20 @@ void gentleRetract(RCBitfield control) {
 }
 
 void flameStart(){
-    safeDigitalWrite(PROPANE_DO, HIGH);
+    safeFastDigitalWrite<PROPANE_DO>(HIGH);
 }
 
 void flameEnd(){
     // seems like this shouldn't require enable, even though disable should close valve itself
-    digitalWrite(PROPANE_DO, LOW);
+    fastDigitalWrite<PROPANE_DO>(LOW);
 }
 
 void valveSafe(){
-    // Safing code deliberately does not use safeDigitalWrite since it should always go through.
-    digitalWrite(ENABLE_VALVE_DO, LOW);
-    digitalWrite(THROW_VALVE_DO, LOW);
-    digitalWrite(VENT_VALVE_DO, LOW);
-    digitalWrite(RETRACT_VALVE_DO, LOW);
+    // Safing code deliberately does not use safeFastDigitalWrite since it should always go through.
+    fastDigitalWrite<ENABLE_VALVE_DO>(LOW);
+    fastDigitalWrite<THROW_VALVE_DO>(LOW);
+    fastDigitalWrite<VENT_VALVE_DO>(LOW);
+    fastDigitalWrite<RETRACT_VALVE_DO>(LOW);
     pinMode(ENABLE_VALVE_DO, OUTPUT);
     pinMode(THROW_VALVE_DO, OUTPUT);
     pinMode(VENT_VALVE_DO, OUTPUT);
@@ -323,19 +537,19 @@ void valveSafe(){
 
 void valveEnable(){
     // Assumes safe() has already been called beforehand, to set pin modes.
-    safeDigitalWrite(ENABLE_VALVE_DO, HIGH);
+    safeFastDigitalWrite<ENABLE_VALVE_DO>(HIGH);
 }
 
 void flameSafe(){
-    digitalWrite(IGNITER_DO, LOW);
-    digitalWrite(PROPANE_DO, LOW);
+    fastDigitalWrite<IGNITER_DO>(LOW);
+    fastDigitalWrite<PROPANE_DO>(LOW);
     pinMode(IGNITER_DO, OUTPUT);
     pinMode(PROPANE_DO, OUTPUT);
 }
 
 void flameEnable(){
     // Assumes safe() has already been called beforehand, to set pin modes.
-    safeDigitalWrite(IGNITER_DO, HIGH);
+    safeFastDigitalWrite<IGNITER_DO>(HIGH);
 }
 
 void safeState(){
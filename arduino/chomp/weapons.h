@@ -15,8 +15,19 @@ bool weaponsEnabled();
 
 void retract( bool check_velocity = true );
 
+// called every loop, seals the vent and starts the flame and hold down
+// while autofire expects a strike so fire() starts the swing sooner
+void preArm(bool strike_expected, bool flame_pulse, bool auto_hold_down);
+
+// microseconds a fire() at now waits for the hold down and the vent before
+// it opens the throw valve, less what pre-arm has already waited
+uint32_t throwValveDelay(uint32_t now, bool auto_hold_down);
+
 void fire( uint16_t hammer_intensity, bool flame_pulse, bool autofire, bool auto_hold_down );
 
+// sends the last swing's trace a packet at a time, called every loop
+void swingTelemStep(uint32_t now);
+
 void noAngleFire( uint16_t hammer_intensity, bool flame_pulse);
 
 void gentleFire( RCBitfield control );
@@ -37,6 +48,9 @@ void flameEnable();
 
 String startElectricHammerMove(int16_t speed);
 
+// a new speed for a move already started
+void electricHammerSpeed(int16_t speed);
+
 void stopElectricHammerMove(void);
 
 void enableState();
@@ -1901,6 +1901,16 @@ int16_t MPU6050::getRotationZ() {
     I2Cdev::readBytes(devAddr, MPU6050_RA_GYRO_ZOUT_H, 2, buffer);
     return (((int16_t)buffer[0]) << 8) | buffer[1];
 }
+/** Get Z-axis gyroscope reading, reporting bus errors.
+ * @param z 16-bit signed integer container for Z-axis rotation
+ * @return I2C error, 0 on success
+ * @see getRotationZ()
+ */
+uint8_t MPU6050::getRotationZ(int16_t* z) {
+    uint8_t err = I2Cdev::readBytes(devAddr, MPU6050_RA_GYRO_ZOUT_H, 2, buffer);
+    *z = (((int16_t)buffer[0]) << 8) | buffer[1];
+    return err;
+}
 
 // EXT_SENS_DATA_* registers
 
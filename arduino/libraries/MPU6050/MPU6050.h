@@ -597,6 +597,7 @@ class MPU6050 {
         int16_t getRotationX();
         int16_t getRotationY();
         int16_t getRotationZ();
+        uint8_t getRotationZ(int16_t* z);
 
         // EXT_SENS_DATA_* registers
         uint8_t getExternalSensorByte(int position);
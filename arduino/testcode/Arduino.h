@@ -1,3 +1,8 @@
 #include <cstdint>
+#include <cstdlib>
+#include "avr/eeprom.h"
+
+class String;
 
 uint32_t micros(void);
+void digitalWrite(uint8_t pin, uint8_t val);
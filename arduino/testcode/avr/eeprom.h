@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+
+// EEPROM is plain memory on the host
+#define EEMEM
+inline void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+    memcpy(dst, src, n);
+}
+inline void eeprom_write_block(const void *src, void *dst, size_t n)
+{
+    memcpy(dst, src, n);
+}
@@ -0,0 +1,6 @@
+#pragma once
+#include <cstdint>
+
+#define PROGMEM
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
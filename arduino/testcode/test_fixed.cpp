@@ -0,0 +1,781 @@
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "fixed.h"
+#include "track.h"
+#include "autofire.h"
+#include "autodrive.h"
+#include "leddar_io.h"
+#include "utils.h"
+#include "gyro_history.h"
+#include "hammer_velocity.h"
+#include "retract_profile.h"
+#include "swing_crossing.h"
+
+// Checks the Fixed template against exact integer arithmetic, then runs
+// the ported targeting code next to the integer code it replaced and
+// reports the worst difference of each.
+
+static int failures = 0;
+
+static void check(const char *name, double worst, double bound)
+{
+    std::cout << name << ": worst difference " << worst
+              << " (bound " << bound << ")";
+    if(worst > bound) {
+        std::cout << " FAIL";
+        failures++;
+    }
+    std::cout << std::endl;
+}
+
+// host stand-ins for the firmware services the targeting code uses
+static uint32_t fake_now = 1;
+static int16_t fake_omegaZ = 0;
+static SegmentGeometry geometry;
+static int32_t telem_x, telem_y;
+uint8_t HAMMER_INTENSITIES_ANGLE[9] = {40, 35, 30, 25, 20, 15, 10, 5, 0};
+volatile bool g_enabled = false;
+
+void digitalWrite(uint8_t pin, uint8_t val) { }
+
+uint32_t micros(void) { return fake_now; }
+bool getOmegaZ(int16_t *omega_z) { *omega_z = fake_omegaZ; return true; }
+uint32_t throwValveDelay(uint32_t now, bool auto_hold_down) { return 0; }
+const SegmentGeometry &getSegmentGeometry(void) { return geometry; }
+static bool strike_armed = false;
+void armStrikeTimer(uint32_t delay) { strike_armed = true; }
+void cancelStrikeTimer(void) { strike_armed = false; }
+void shadowLogFrame(uint32_t time, enum AutofireState state,
+                    int16_t intensity, int32_t swing, int32_t strike,
+                    Millimeters x, Millimeters y) { }
+bool sendAutofireTelemetry(enum AutofireState st, int32_t swing,
+                           int32_t strike, int32_t x, int32_t y)
+{
+    telem_x = x;
+    telem_y = y;
+    return true;
+}
+bool sendSwingDurationTelemetry(const uint16_t *duration, const uint8_t *count)
+{
+    return true;
+}
+static uint32_t retract_duration;
+bool sendRetractTelemetry(uint8_t source, bool complete, uint32_t duration,
+                          uint16_t start_angle, uint16_t end_angle,
+                          int16_t peak_speed)
+{
+    retract_duration = duration;
+    return true;
+}
+bool sendAutodriveTelemetry(int16_t steer_bias, int16_t drive_bias,
+                            int16_t theta, int16_t vtheta,
+                            int16_t r, int16_t vr, int16_t rate_setpoint,
+                            int16_t rate_error, int16_t rate_integral)
+{
+    return true;
+}
+
+static int32_t random32(int32_t range)
+{
+    return (int32_t)(((int64_t)rand() << 16 ^ rand()) % (2 * (int64_t)range + 1)
+                     - range);
+}
+
+static int64_t floorShift(int64_t v, int shift)
+{
+    return v >= 0 ? v >> shift : -((-v + (1LL << shift) - 1) >> shift);
+}
+
+static void testFixed()
+{
+    double rescale = 0, sat = 0, mul16 = 0, mul32 = 0, quotient = 0;
+    srand(2);
+    for(int i = 0; i < 200000; i++) {
+        int32_t a = random32(100000000L);
+        Fixed<int32_t, 4> q4 = Fixed<int32_t, 4>::fromRaw(a);
+        rescale = std::max(rescale, (double)std::llabs(
+            Fixed<int32_t, 2>::from(q4).raw() - floorShift(a, 2)));
+        rescale = std::max(rescale, (double)std::llabs(
+            Fixed<int32_t, 6>::from(Fixed<int32_t, 2>::fromRaw(a / 16)).raw()
+            - (int64_t)(a / 16) * 16));
+
+        int16_t s = random32(32767);
+        int16_t t = random32(32767);
+        int32_t clamped = std::min(32767, std::max(-32768, s + t));
+        sat = std::max(sat, (double)std::abs(
+            Fixed<int16_t, 8>::fromRaw(s).satAdd(
+                Fixed<int16_t, 8>::fromRaw(t)).raw() - clamped));
+        clamped = std::min(32767, std::max(-32768, s - t));
+        sat = std::max(sat, (double)std::abs(
+            Fixed<int16_t, 8>::fromRaw(s).satSub(
+                Fixed<int16_t, 8>::fromRaw(t)).raw() - clamped));
+
+        // 16x16 into Q11 from Q8*Q14, and 32x16 into Q4 from Q4*Q15
+        int32_t p16 = Fixed<int16_t, 8>::fromRaw(s).mul<Fixed<int32_t, 11> >(
+            Fixed<int16_t, 14>::fromRaw(t)).raw();
+        mul16 = std::max(mul16, (double)std::llabs(
+            p16 - floorShift((int64_t)s * t, 11)));
+        int32_t p32 = q4.mul<Fixed<int32_t, 4> >(
+            Fixed<int16_t, 15>::fromRaw(t)).raw();
+        mul32 = std::max(mul32, (double)std::llabs(
+            p32 - floorShift((int64_t)a * t, 15)));
+
+        int32_t d = random32(1000000L);
+        if(d != 0) {
+            double exact = (double)a * 2048 / d;
+            if(std::fabs(exact) < 2e9 && std::fabs(exact) > 1000) {
+                int32_t q = q4.div<Fixed<int32_t, 11> >(
+                    Fixed<int32_t, 4>::fromRaw(d)).raw();
+                quotient = std::max(quotient,
+                                    (std::fabs(q - exact) - 0.5) /
+                                    std::fabs(exact));
+            }
+        }
+    }
+    check("Fixed::from", rescale, 0);
+    check("Fixed::satAdd/satSub", sat, 0);
+    check("Fixed::mul 16x16", mul16, 0);
+    check("Fixed::mul 32x16", mul32, 0);
+    check("Fixed::div (relative)", quotient, 1.0 / 8192);
+}
+
+// 16 segments over 99 degrees, the default LEDDAR parameters
+static void setupGeometry()
+{
+    const double width = 99.0 / 16 * M_PI / 180;
+    geometry.segments = 16;
+    geometry.width = std::lround(width * 2048);
+    for(int i = 0; i < 16; i++) {
+        double a = (7.5 - i) * width;
+        geometry.angle[i] = std::lround(a * 2048);
+        geometry.cosine[i] = std::lround(std::cos(a) * 16384);
+        geometry.sine[i] = std::lround(std::sin(a) * 16384);
+    }
+}
+
+// the object features as computed before the port
+static int16_t legacyInterpolate(const int16_t (&table)[LEDDAR_SEGMENTS],
+                                 int16_t centroid)
+{
+    uint8_t i = centroid >> 8;
+    int16_t frac = centroid & 0xff;
+    if(i >= LEDDAR_SEGMENTS - 1) {
+        return table[LEDDAR_SEGMENTS - 1];
+    }
+    return table[i] + (((int32_t)(table[i + 1] - table[i]) * frac) >> 8);
+}
+
+static void testObject()
+{
+    double angle = 0, position = 0;
+    srand(3);
+    for(int i = 0; i < 20000; i++) {
+        Object o;
+        o.LeftEdge = rand() % 15;
+        o.RightEdge = o.LeftEdge + 1 + rand() % (16 - o.LeftEdge);
+        int width = o.RightEdge - o.LeftEdge;
+        o.VisibleSegments = width;
+        o.SumDistance = width * (20 + rand() % 1000);
+        o.SumIntensity = 0;
+        o.SumAngleIntensity = 0;
+        for(int s = o.LeftEdge; s < o.RightEdge; s++) {
+            int amplitude = rand() % 200;
+            o.SumIntensity += amplitude;
+            o.SumAngleIntensity += amplitude * s;
+        }
+        o.computeFeatures();
+
+        int16_t centroid = o.SumIntensity <= 0 ?
+            (int16_t)(o.LeftEdge + o.RightEdge - 1) * 128 :
+            o.SumAngleIntensity * 256L / o.SumIntensity;
+        int16_t legacy_angle = geometry.angle[0] -
+            ((int32_t)centroid * geometry.width) / 256L;
+        int16_t legacy_x = ((int32_t)o.Radius *
+            legacyInterpolate(geometry.cosine, centroid)) >> 14;
+        int16_t legacy_y = ((int32_t)o.Radius *
+            legacyInterpolate(geometry.sine, centroid)) >> 14;
+        angle = std::max(angle, (double)std::abs(o.Angle.raw() - legacy_angle));
+        position = std::max(position, (double)std::abs(o.X.toInt() - legacy_x));
+        position = std::max(position, (double)std::abs(o.Y.toInt() - legacy_y));
+    }
+    check("Object angle (radians*2048)", angle, 0);
+    check("Object x/y (mm)", position, 0);
+}
+
+// the alpha-beta tracker as it was before the port, all values raw
+struct LegacyTrack {
+    int32_t x, vx, y, vy;
+    int32_t last_omgaz;
+    int16_t alpha, beta;
+
+    LegacyTrack() : x(0), vx(0), y(0), vy(0), last_omgaz(0),
+                    alpha(9000), beta(8192) { }
+
+    int16_t updateOmegaZ(int32_t dt, int16_t omegaZ) {
+        int32_t converted = (int32_t)omegaZ*35;
+        int32_t average_omegaZ = (last_omgaz + converted)/2;
+        last_omgaz = converted;
+        return ((average_omegaZ/16)*(dt/1000))/1000;
+    }
+
+    void project(int32_t dt, int32_t dtheta, int32_t *px, int32_t *py) const {
+        int16_t c = fixedCos(dtheta);
+        int16_t s = fixedSin(dtheta);
+        int32_t lx=*px;
+        int32_t ly=*py;
+        *px = ((dt/1000)*vx)/1000 + mulQ14(lx, c) + mulQ14(ly, s);
+        *py = ((dt/1000)*vy)/1000 + mulQ14(ly, c) - mulQ14(lx, s);
+    }
+
+    void update(int32_t mx, int32_t my) {
+        int32_t rx = mx*16 - x;
+        if(rx>65535L) rx=65535L;
+        if(rx<-65535L) rx=-65535L;
+        int32_t ry = my*16 - y;
+        if(ry>65535L) ry=65535L;
+        if(ry<-65535L) ry=-65535L;
+        x += alpha*rx/32767;
+        y += alpha*ry/32767;
+        vx += beta*rx/4096;
+        vx = clip(vx, (int32_t)-10000*16, (int32_t)10000*16);
+        vy += beta*ry/4096;
+        vy = clip(vy, (int32_t)-10000*16, (int32_t)10000*16);
+    }
+
+    int32_t vtheta() const {
+        int32_t mx = std::min(std::max(x/16, -16383), 16383);
+        int32_t my = std::min(std::max(y/16, -16383), 16383);
+        int32_t num = (vy/16)*mx - (vx/16)*my;
+        int32_t den = mx*mx + my*my;
+        return fixedDivide(num, den, 11);
+    }
+};
+
+// an opponent circling in front of us while we spin slowly
+static void testTrack()
+{
+    double position = 0, velocity = 0, angle = 0, rate = 0;
+    Track track;
+    LegacyTrack legacy;
+    // start with a stale track so the first observation initializes it
+    fake_now += 1000000;
+    track.setTrackingFilterParams(9000, 8192, 3, 250000, 1000, 6000, false,
+                                  false, 3000, 40, 16);
+    const int32_t frame = 20000;
+    for(int k = 0; k < 500; k++) {
+        fake_now += frame;
+        fake_omegaZ = 300 * std::sin(k / 40.0);
+        double phase = k / 25.0;
+        Object o;
+        o.X = Millimeters::fromInt(1500 + 600 * std::cos(phase));
+        o.Y = Millimeters::fromInt(800 * std::sin(phase));
+        o.Time = fake_now;
+        if(k == 0) {
+            track.update(o);
+            track.last_predict = fake_now;
+            legacy.x = o.X.raw();
+            legacy.y = o.Y.raw();
+            continue;
+        }
+        int32_t dtheta = legacy.updateOmegaZ(frame, fake_omegaZ);
+        track.predict(fake_now, Radians::fromRaw(dtheta));
+        legacy.project(frame, dtheta, &legacy.x, &legacy.y);
+        track.update(o);
+        legacy.update(o.X.toInt(), o.Y.toInt());
+
+        position = std::max(position, std::fabs(track.x.raw() - legacy.x) / 16.0);
+        position = std::max(position, std::fabs(track.y.raw() - legacy.y) / 16.0);
+        velocity = std::max(velocity, std::fabs(track.vx.raw() - legacy.vx) / 16.0);
+        velocity = std::max(velocity, std::fabs(track.vy.raw() - legacy.vy) / 16.0);
+
+        // same state in both, so angle and rate only see the arithmetic
+        legacy.x = track.x.raw();
+        legacy.y = track.y.raw();
+        legacy.vx = track.vx.raw();
+        legacy.vy = track.vy.raw();
+        if(k > 10) {
+            angle = std::max(angle, (double)std::abs(
+                track.angle().raw() - fixedAtan2(legacy.y, legacy.x)));
+            rate = std::max(rate, (double)std::abs(
+                track.vtheta().raw() - legacy.vtheta()));
+        }
+    }
+    // one step from the same state. The gyro rotation now rounds down
+    // where it used to truncate, 1/2048 radian at ~2 m is 1 mm, and
+    // the velocity gain of 2 doubles that
+    check("Track x/y (mm)", position, 1);
+    check("Track vx/vy (mm/s)", velocity, 2.5);
+    check("Track angle (radians*2048)", angle, 0);
+    check("Track vtheta (radians/s*2048)", rate, 4);
+}
+
+static void testPidSteer()
+{
+    const int16_t steer_p = 1024, steer_d = 300, rate_max = 8192, rate_p = 800;
+    const int16_t drive_p = 1500, drive_d = 300;
+    const int16_t depth = 600;
+    setDriveControlParams(steer_p, steer_d, rate_max, rate_p, 0, 600,
+                          drive_p, drive_d, 600);
+    double steer = 0, drive = 0;
+    srand(4);
+    Track track;
+    track.setTrackingFilterParams(9000, 8192, 3, 250000, 1000, 6000, false,
+                                  false, 3000, 40, 16);
+    for(int i = 0; i < 20000; i++) {
+        fake_now += 1000;
+        fake_omegaZ = random32(1500);
+        track.last_update = fake_now;
+        track.last_predict = fake_now;
+        track.num_updates = 10;
+        track.x = Millimeters::fromRaw(random32(4000 * 16L));
+        track.y = Millimeters::fromRaw(random32(4000 * 16L));
+        // vtheta works in whole mm, which up close swamps the rounding
+        // differences this is looking for
+        if(std::abs(track.x.toInt()) + std::abs(track.y.toInt()) < 500) {
+            continue;
+        }
+        track.vx = MillimetersPerSec::fromRaw(random32(5000 * 16L));
+        track.vy = MillimetersPerSec::fromRaw(random32(5000 * 16L));
+        int16_t drive_bias, steer_bias;
+        pidSteer(track, depth, true, &drive_bias, &steer_bias);
+
+        // the bearing then the gyro loop in double precision, no integral,
+        // from the track's own vtheta which has its own check above
+        int32_t theta = fixedAtan2(track.y.raw(), track.x.raw());
+        LegacyTrack legacy;
+        legacy.x = track.x.raw();
+        legacy.y = track.y.raw();
+        legacy.vx = track.vx.raw();
+        legacy.vy = track.vy.raw();
+        double rate = (theta * steer_p +
+                       track.vtheta().raw() * steer_d) / 256.0;
+        rate = std::min(std::max(rate, (double)-rate_max), (double)rate_max);
+        double error = rate - fake_omegaZ * 35 / 16;
+        double reference = std::min(std::max(-error * rate_p / 16384, -600.0),
+                                    600.0);
+
+        // the integer code before the port
+        int32_t x = legacy.x / 4, y = legacy.y / 4;
+        int32_t vx = legacy.vx / 4, vy = legacy.vy / 4;
+        int32_t tracked_r = fixedSqrt((uint32_t)(x*x + y*y));
+        int32_t tracked_vr = fixedSqrt((uint32_t)(vx*vx + vy*vy));
+        int32_t bias  = drive_p * ((int32_t)depth*4L - tracked_r)/16384L;
+        bias += -drive_d * tracked_vr * 4 / 16384L;
+        int32_t legacy_drive = std::min(std::max(bias, -600), 600);
+
+        steer = std::max(steer, std::fabs(steer_bias - reference));
+        drive = std::max(drive, (double)std::abs(drive_bias - legacy_drive));
+    }
+    check("pidSteer steer bias", steer, 2);
+    check("pidSteer drive bias", drive, 2);
+
+    // integral only: a target held at 0.5 rad with the robot not turning
+    // ramps the bias at rate_i * setpoint per second until steer_max
+    const int16_t rate_i = 800;
+    setDriveControlParams(steer_p, 0, rate_max, 0, rate_i, 600,
+                          drive_p, drive_d, 600);
+    fake_omegaZ = 0;
+    track.vx = MillimetersPerSec();
+    track.vy = MillimetersPerSec();
+    track.x = Millimeters::fromInt(1000);
+    track.y = Millimeters::fromInt(546);
+    double setpoint = fixedAtan2(track.y.raw(), track.x.raw()) *
+                      steer_p / 256.0;
+    int16_t drive_bias, steer_bias;
+    recordGyro(fake_now, 0);
+    track.num_updates = 0;
+    pidSteer(track, depth, true, &drive_bias, &steer_bias);
+    track.num_updates = 10;
+    double ramp = 0;
+    for(int i = 1; i <= 100; i++) {
+        fake_now += 10000;
+        track.last_update = fake_now;
+        track.last_predict = fake_now;
+        recordGyro(fake_now, 0);
+        pidSteer(track, depth, i == 1, &drive_bias, &steer_bias);
+        double reference = std::max(-setpoint * i / 100 * rate_i / 16384,
+                                    -600.0);
+        ramp = std::max(ramp, std::fabs(steer_bias - reference));
+    }
+    check("pidSteer integral ramp", ramp, 2);
+
+    // the integral stops at steer_max, so the bias leaves the limit on the
+    // first sample after the target crosses over
+    track.y = Millimeters::fromInt(-546);
+    fake_now += 10000;
+    track.last_update = fake_now;
+    track.last_predict = fake_now;
+    recordGyro(fake_now, 0);
+    pidSteer(track, depth, true, &drive_bias, &steer_bias);
+    check("pidSteer integral unwinds", steer_bias > -600 ? 0 : 1, 0);
+}
+
+// the body frame projection in double precision: turning at omega with
+// the velocity fixed along the body axes, T seconds on
+static void arcReference(const Track &track, double omega, double T,
+                         double *px, double *py)
+{
+    double x0 = track.x.raw() / 16.0, y0 = track.y.raw() / 16.0;
+    double vx = track.vx.raw() / 16.0, vy = track.vy.raw() / 16.0;
+    double theta = omega * T;
+    double c = std::cos(theta), s = std::sin(theta);
+    double sinc = theta == 0 ? T : s / omega;
+    double cosc = theta == 0 ? 0 : (1 - c) / omega;
+    *px = x0 * c + y0 * s + vx * sinc + vy * cosc;
+    *py = y0 * c - x0 * s + vy * sinc - vx * cosc;
+}
+
+// one step projection over every swing duration plus the strike horizon,
+// slow turns on the series and fast ones on the trig tables
+static void testProject()
+{
+    double slow = 0, fast = 0;
+    srand(7);
+    Track track;
+    for(int i = 0; i < 20000; i++) {
+        track.x = Millimeters::fromRaw(random32(3000 * 16L));
+        track.y = Millimeters::fromRaw(random32(3000 * 16L));
+        track.vx = MillimetersPerSec::fromRaw(random32(4000 * 16L));
+        track.vy = MillimetersPerSec::fromRaw(random32(4000 * 16L));
+        int32_t dt = swingDuration(rand() % 9) + rand() % 100001;
+        bool spin = i % 2;
+        RadiansPerSec omegaZ = RadiansPerSec::fromRaw(
+            random32(spin ? 20 * 2048L : 2 * 2048L));
+        Millimeters x, y;
+        track.lookahead(dt, omegaZ, &x, &y);
+        double rx, ry;
+        // the turn the firmware applies, whole milliseconds
+        double theta = ((dt / 1000) * omegaZ.raw() / 1000) / 2048.0;
+        arcReference(track, theta / (dt / 1e6), dt / 1e6, &rx, &ry);
+        double error = std::hypot(x.raw() / 16.0 - rx, y.raw() / 16.0 - ry);
+        double &worst = std::fabs(theta) < 1 ? slow : fast;
+        worst = std::max(worst, error);
+    }
+    check("project below a radian vs double (mm)", slow, 2);
+    check("project above a radian vs double (mm)", fast, 4);
+}
+
+// the strike decision now against the double precision projection
+static void testScheduleAutofire()
+{
+    setAutoFireParams(200, 200, 1787, 0);
+    double position = 0;
+    int mismatched = 0;
+    srand(5);
+    Track track;
+    track.setTrackingFilterParams(9000, 8192, 3, 250000, 1000, 6000, false,
+                                  false, 3000, 40, 16);
+    for(int i = 0; i < 20000; i++) {
+        fake_now += 1000;
+        fake_omegaZ = random32(800);
+        track.last_update = fake_now;
+        track.last_predict = fake_now;
+        track.num_updates = 10;
+        track.x = Millimeters::fromRaw(random32(1500 * 16L));
+        track.y = Millimeters::fromRaw(random32(600 * 16L));
+        track.vx = MillimetersPerSec::fromRaw(random32(3000 * 16L));
+        track.vy = MillimetersPerSec::fromRaw(random32(3000 * 16L));
+        int16_t intensity = rand() % 9;
+        enum AutofireState st = scheduleAutofire(track, 600, intensity, false);
+        if(st == AF_OMEGAZ_LOCKOUT) {
+            continue;
+        }
+
+        int32_t swing = swingDuration(intensity);
+        int32_t omegaZ = (int32_t)fake_omegaZ*35L/16L;
+        double theta = ((swing / 1000) * omegaZ / 1000) / 2048.0;
+        double x, y;
+        arcReference(track, theta / (swing / 1e6), swing / 1e6, &x, &y);
+        bool hit = x > 0 && x < 600 && std::fabs(y) < 200;
+        position = std::max(position, std::fabs(telem_x - x));
+        position = std::max(position, std::fabs(telem_y - y));
+        if(hit != (st == AF_HIT)) {
+            mismatched++;
+        }
+    }
+    // telemetry carries whole mm on top of the projection's rounding
+    check("scheduleAutofire projected x/y (mm)", position, 2);
+    check("scheduleAutofire decisions differing", mismatched, 5);
+}
+
+// Without rotation the path is straight, so the strike time is exact up to
+// rounding. Compared against stepping the swing start 10us at a time, as
+// the distance the target moves between the two times.
+static void testStrikeTime()
+{
+    setAutoFireParams(200, 200, 1787, 0);
+    double timing = 0;
+    int mismatched = 0, armed = 0;
+    srand(6);
+    Track track;
+    track.setTrackingFilterParams(9000, 8192, 3, 250000, 1000, 6000, false,
+                                  false, 3000, 40, 16);
+    for(int i = 0; i < 5000; i++) {
+        track.x = Millimeters::fromRaw(random32(1500 * 16L));
+        track.y = Millimeters::fromRaw(random32(600 * 16L));
+        track.vx = MillimetersPerSec::fromRaw(random32(3000 * 16L));
+        track.vy = MillimetersPerSec::fromRaw(random32(3000 * 16L));
+        int32_t lead = swingDuration(rand() % 9);
+        Millimeters x, y;
+        int32_t strike = strikeTime(track, lead, RadiansPerSec(), 600, &x, &y);
+
+        double x0 = track.x.raw() / 16.0, y0 = track.y.raw() / 16.0;
+        double vx = track.vx.raw() / 16.0, vy = track.vy.raw() / 16.0;
+        int32_t expected = -1;
+        for(int32_t t = 0; t <= 100000; t += 10) {
+            double s = (lead + t) / 1e6;
+            double bx = x0 + vx * s, by = y0 + vy * s;
+            if(bx > 0 && bx < 600 && std::fabs(by) < 200) {
+                expected = t;
+                break;
+            }
+        }
+        if((strike < 0) != (expected < 0)) {
+            mismatched++;
+        } else if(strike >= 0) {
+            armed += strike > 0;
+            double speed = std::hypot(vx, vy);
+            timing = std::max(timing, std::abs(strike - expected) * speed / 1e6);
+        }
+    }
+    std::cout << armed << " strikes armed ahead" << std::endl;
+    check("strikeTime vs stepped swing start (mm)", timing, 1);
+    check("strikeTime hit or miss differing", mismatched, 5);
+}
+
+static void expect(const char *name, bool ok)
+{
+    std::cout << name << (ok ? "" : " FAIL") << std::endl;
+    if(!ok) {
+        failures++;
+    }
+}
+
+// Strike times found in a hammer trace and folded into the table
+static void testSwingDurations()
+{
+    resetSwingDurations();
+    expect("swing durations start from the hand fit",
+           swingDuration(0) == 230000);
+
+    // 2ms samples accelerating from 25 degrees, crossing 221 between
+    // samples 20 and 21
+    uint16_t trace[40];
+    for(int i = 0; i < 40; i++) {
+        trace[i] = std::min(25 + i * i / 2 + i * 3 / 2, 240);
+    }
+    int32_t strike = traceStrikeTime(trace, 40, 2000, 221);
+    double exact = 0;
+    for(int i = 1; i < 40; i++) {
+        if(trace[i] >= 221) {
+            exact = 2000 * (i - 1 + (221.0 - trace[i - 1]) /
+                                    (trace[i] - trace[i - 1]));
+            break;
+        }
+    }
+    check("traceStrikeTime (us)", std::abs(strike - exact), 1);
+    expect("traceStrikeTime misses a short swing",
+           traceStrikeTime(trace, 10, 2000, 221) == -1);
+
+    expect("learnSwingDuration rejects a stall", !learnSwingDuration(0, 1500000));
+    expect("first swing replaces the hand fit",
+           learnSwingDuration(0, 250000) && swingDuration(0) == 250000);
+    for(int i = 0; i < 40; i++) {
+        learnSwingDuration(0, 270000);
+    }
+    check("running average settles (us)",
+          std::abs(swingDuration(0) - 270000), 100);
+    learnSwingDuration(0, 310000);
+    check("one swing moves it an eighth (us)",
+          std::abs(swingDuration(0) - 275000), 100);
+    int32_t learned = swingDuration(0);
+    restoreSwingDurations();
+    expect("learned durations survive a restore",
+           swingDuration(0) == learned && swingDuration(2) == 232000);
+    resetSwingDurations();
+}
+
+// The sliding fit against a double least squares slope of the same
+// (time, angle) samples, the angles quantized to whole degrees as the
+// sensor reads them
+static void testHammerVelocity()
+{
+    hammerVelocityReset();
+    int16_t velocity;
+    fake_now = 5000000;
+    hammerVelocitySample(fake_now, 100);
+    expect("hammerVelocity waits for samples", !hammerVelocity(&velocity));
+
+    const double rates[] = {0, 40, -60, 900, -2500, 6000};
+    double worst = 0;
+    for(double rate : rates) {
+        hammerVelocityReset();
+        std::vector<double> t, a;
+        double angle = 180;
+        for(int i = 0; i < 30; i++) {
+            // uneven 2-5ms steps like the main loop's
+            uint32_t step = 2000 + (i * 1237) % 3000;
+            fake_now += step;
+            angle += rate * step / 1e6;
+            uint16_t reading = std::lround(angle - 360 * std::floor(angle / 360));
+            hammerVelocitySample(fake_now, reading);
+            t.push_back(fake_now);
+            a.push_back(reading);
+        }
+        double mt = 0, ma = 0;
+        int n = 0;
+        for(int i = t.size() - 1; i >= 0 && fake_now - t[i] <= HAMMER_VELOCITY_WINDOW; i--) {
+            mt += t[i];
+            ma += a[i];
+            n++;
+        }
+        mt /= n;
+        ma /= n;
+        double tt = 0, ta = 0;
+        for(int i = t.size() - n; i < (int)t.size(); i++) {
+            tt += (t[i] - mt) * (t[i] - mt);
+            ta += (t[i] - mt) * (a[i] - ma);
+        }
+        double exact = 1e6 * ta / tt;
+        if(!hammerVelocity(&velocity)) {
+            expect("hammerVelocity valid with a full window", false);
+            continue;
+        }
+        worst = std::max(worst, std::abs(velocity - exact) /
+                                std::max(std::abs(exact), 50.0));
+    }
+    // integer means and 64us time steps, against the fit's own scale
+    check("hammerVelocity relative to the double fit", worst, 0.02);
+
+    fake_now += 60000;
+    expect("hammerVelocity goes stale without samples",
+           !hammerVelocity(&velocity));
+    hammerVelocityReset();
+}
+
+// Full command far from the stop, braking on the sqrt profile near it,
+// the speed error on top when the velocity fit is valid
+static void testRetractProfile()
+{
+    restoreRetractParameters();
+    hammerVelocityReset();
+    expect("retract runs full far from the stop",
+           retractCommand(200, 45) == 1000);
+    // 10 degrees out at 4000 deg/s^2 the target is sqrt(80000) = 282 deg/s
+    check("retract target near the stop",
+          std::abs(retractCommand(55, 45) - 282 * 1000 / 400), 3);
+    expect("retract never drops below the minimum",
+           retractCommand(46, 45) == 300);
+    expect("retract stops at the stop angle", retractCommand(45, 45) == 0);
+
+    // retracting at 400 deg/s with 10 degrees to go is 118 deg/s too fast
+    for(int i = 0; i < 10; i++) {
+        fake_now += 5000;
+        hammerVelocitySample(fake_now, 75 - 2 * i);
+    }
+    check("retract brakes on the measured speed",
+          std::abs(retractCommand(55, 45) - (705 - 118)), 3);
+
+    retractStarted(RETRACT_MANUAL, 75);
+    fake_now += 123456;
+    retractFinished(45, true);
+    expect("retract duration reported", retract_duration == 123456);
+    hammerVelocityReset();
+}
+
+// The fixed point crossing fit next to the float fit it replaced, over
+// swing rates and polls from the capture interrupt's to the slow loop's
+static double floatCrossing(const AngleSamples& samples, uint16_t target)
+{
+    uint32_t newest = samples.time[(samples.count - 1) % CROSSING_SAMPLES];
+    double st = 0, sa = 0, stt = 0, sta = 0;
+    for(int i = 0; i < CROSSING_SAMPLES; i++) {
+        double t = (int32_t)(samples.time[i] - newest);
+        st += t;
+        sa += samples.angle[i];
+        stt += t * t;
+        sta += t * samples.angle[i];
+    }
+    double n = CROSSING_SAMPLES;
+    return (st + (n * target - sa) * (n * stt - st * st) /
+            (n * sta - st * sa)) / n;
+}
+
+static void testPredictCrossing()
+{
+    uint32_t crossing;
+    AngleSamples samples = {};
+    addAngleSample(samples, 1000, 30);
+    expect("predictCrossing waits for the samples",
+           !predictCrossing(samples, 200, &crossing));
+
+    const double rates[] = {300, 1500, 3000, 6000};
+    const uint32_t polls[] = {250, 1000, 2000, 4000};
+    double worst = 0;
+    for(double rate : rates) {
+        for(uint32_t poll : polls) {
+            samples = AngleSamples();
+            double angle = 40;
+            uint32_t t = 0xfffff000UL;  // across the micros() wrap
+            for(int i = 0; i < 6; i++) {
+                t += poll + (i * 97) % 200;
+                angle += rate * poll / 1e6;
+                addAngleSample(samples, t, std::lround(angle));
+            }
+            for(uint16_t target : {90, 150, 221}) {
+                double exact = floatCrossing(samples, target);
+                if(exact > 250000) {
+                    continue;
+                }
+                if(!predictCrossing(samples, target, &crossing)) {
+                    expect("predictCrossing finds a reachable crossing", false);
+                    continue;
+                }
+                double got = (int32_t)(crossing - t);
+                worst = std::max(worst, std::abs(got - exact) /
+                                        std::max(exact, 1000.0));
+            }
+        }
+    }
+    // 4us time steps, relative to how far ahead the crossing is
+    check("predictCrossing relative to the float fit", worst, 0.002);
+
+    samples = AngleSamples();
+    for(int i = 0; i < 4; i++) {
+        addAngleSample(samples, 1000 + 2000 * i, 200 - 5 * i);
+    }
+    expect("predictCrossing ignores a hammer moving away",
+           !predictCrossing(samples, 221, &crossing));
+    samples = AngleSamples();
+    for(int i = 0; i < 4; i++) {
+        addAngleSample(samples, 1000 + 10000 * i, 40 + 30 * i);
+    }
+    expect("predictCrossing ignores samples over 16ms apart",
+           !predictCrossing(samples, 221, &crossing));
+    samples = AngleSamples();
+    for(int i = 0; i < 4; i++) {
+        addAngleSample(samples, 1000 + 4000 * i, 40 + (i > 1));
+    }
+    expect("predictCrossing ignores a crossing out of timer reach",
+           !predictCrossing(samples, 221, &crossing));
+}
+
+int main()
+{
+    setupGeometry();
+    restoreSwingDurations();
+    testFixed();
+    testObject();
+    testTrack();
+    testPidSteer();
+    testSwingDurations();
+    testProject();
+    testScheduleAutofire();
+    testStrikeTime();
+    testHammerVelocity();
+    testRetractProfile();
+    testPredictCrossing();
+    return failures;
+}
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include "fixed_math.h"
+
+// Checks the fixed point kernels against float references over their
+// input ranges and reports the worst case error of each.
+
+static int failures = 0;
+
+static void check(const char *name, double worst, double bound)
+{
+    std::cout << name << ": worst error " << worst
+              << " (bound " << bound << ")";
+    if(worst > bound) {
+        std::cout << " FAIL";
+        failures++;
+    }
+    std::cout << std::endl;
+}
+
+static void testSinCos()
+{
+    double worst_sin = 0, worst_cos = 0;
+    for(int32_t a = -32768; a < 32768; a++) {
+        double r = a / 2048.0;
+        double s = std::round(16384 * std::sin(r));
+        double c = std::round(16384 * std::cos(r));
+        worst_sin = std::max(worst_sin, std::fabs(fixedSin(a) - s));
+        worst_cos = std::max(worst_cos, std::fabs(fixedCos(a) - c));
+    }
+    check("fixedSin", worst_sin, 2);
+    check("fixedCos", worst_cos, 2);
+}
+
+static void testAtan2()
+{
+    double worst = 0;
+    srand(1);
+    for(int i = 0; i < 200000; i++) {
+        int32_t x = (rand() % 200001) - 100000;
+        int32_t y = (rand() % 200001) - 100000;
+        if(i % 4 == 0) {
+            x /= 1000;
+            y /= 1000;
+        }
+        double ref = std::round(2048 * std::atan2((double)y, (double)x));
+        if(x == 0 && y == 0) ref = 0;
+        int16_t a = fixedAtan2(y, x);
+        // +pi and -pi are the same angle
+        double err = std::fabs(a - ref);
+        err = std::min(err, std::fabs(std::fabs(err) - 2 * 6433.98));
+        worst = std::max(worst, err);
+    }
+    check("fixedAtan2", worst, 1);
+}
+
+static void testSqrt()
+{
+    double worst = 0;
+    for(uint32_t n = 0; n < 1000000; n++) {
+        uint32_t ref = (uint32_t)std::floor(std::sqrt((double)n));
+        worst = std::max(worst, std::fabs((double)fixedSqrt(n) - ref));
+    }
+    srand(2);
+    for(int i = 0; i < 1000000; i++) {
+        uint32_t n = ((uint32_t)rand() << 16) ^ rand();
+        uint32_t ref = (uint32_t)std::floor(std::sqrt((double)n));
+        worst = std::max(worst, std::fabs((double)fixedSqrt(n) - ref));
+    }
+    worst = std::max(worst, std::fabs((double)fixedSqrt(0xffffffffUL) - 65535));
+    check("fixedSqrt", worst, 0);
+}
+
+static void testReciprocal()
+{
+    double worst = 0;
+    for(uint32_t d = 0x8001; d <= 0xffff; d++) {
+        double ref = std::round(2147483648.0 / d);
+        worst = std::max(worst, std::fabs(fixedReciprocal(d) - ref));
+    }
+    check("fixedReciprocal", worst, 1);
+}
+
+static void testDivide()
+{
+    double worst = 0;
+    srand(3);
+    for(int i = 0; i < 1000000; i++) {
+        int32_t num = ((rand() % 2000001) - 1000000) * (1 + rand() % 100);
+        int32_t den = (rand() % 2000001) - 1000000;
+        if(den == 0 || num == 0) continue;
+        uint8_t frac = rand() % 12;
+        double ref = (double)num / den * (1 << frac);
+        if(std::fabs(ref) > 1e9 || std::fabs(ref) < 1000) continue;
+        // ignore the quantization of the integer result
+        double err = std::fabs(fixedDivide(num, den, frac) - ref) - 0.5;
+        err = std::max(0.0, err) / std::fabs(ref);
+        worst = std::max(worst, err);
+    }
+    check("fixedDivide (relative)", worst, 1.0 / 8192);
+}
+
+int main()
+{
+    testSinCos();
+    testAtan2();
+    testSqrt();
+    testReciprocal();
+    testDivide();
+    return failures ? 1 : 0;
+}
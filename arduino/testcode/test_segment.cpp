@@ -0,0 +1,128 @@
+#include <iostream>
+#include <cmath>
+#include "targeting.h"
+
+// Runs segmentObjects over hand built frames and checks the objects it
+// calls, including ones partly hidden behind nearer objects.
+
+static int failures = 0;
+
+// host stand-ins for the firmware services the targeting code uses
+static SegmentGeometry geometry;
+volatile bool g_enabled = false;
+
+uint32_t micros(void) { return 0; }
+void digitalWrite(uint8_t pin, uint8_t val) { }
+bool getOmegaZ(int16_t *omega_z) { *omega_z = 0; return true; }
+const SegmentGeometry &getSegmentGeometry(void) { return geometry; }
+MillimetersPerSec getEgoVelocity(uint32_t now) { return MillimetersPerSec(); }
+
+static void setupGeometry()
+{
+    const double width = 99.0 / 16 * M_PI / 180;
+    geometry.segments = 16;
+    geometry.width = std::lround(width * 2048);
+    for(int i = 0; i < 16; i++) {
+        double a = (7.5 - i) * width;
+        geometry.angle[i] = std::lround(a * 2048);
+        geometry.cosine[i] = std::lround(std::cos(a) * 16384);
+        geometry.sine[i] = std::lround(std::sin(a) * 16384);
+    }
+}
+
+struct Expected {
+    int8_t left, right, visible;
+    bool partial;
+};
+
+static void check(const char *name, const int16_t (&distance)[16],
+                  const Expected *expected, uint8_t num_expected,
+                  uint16_t overflows)
+{
+    Detection detections[LEDDAR_SEGMENTS];
+    for(int i = 0; i < 16; i++) {
+        detections[i].Segment = i;
+        detections[i].Distance = distance[i];
+        detections[i].Amplitude = 100;
+    }
+    Object objects[8];
+    uint16_t before = getSegmentationOverflows();
+    uint8_t num_objects = segmentObjects(detections, 0, objects);
+    bool ok = num_objects == num_expected &&
+              getSegmentationOverflows() - before == overflows;
+    for(uint8_t i = 0; ok && i < num_objects; i++) {
+        ok = objects[i].LeftEdge == expected[i].left &&
+             objects[i].RightEdge == expected[i].right &&
+             objects[i].VisibleSegments == expected[i].visible &&
+             objects[i].Partial == expected[i].partial;
+    }
+    std::cout << name << ": " << (int)num_objects << " objects";
+    for(uint8_t i = 0; i < num_objects; i++) {
+        std::cout << " [" << (int)objects[i].LeftEdge << ","
+                  << (int)objects[i].RightEdge << ")/"
+                  << (int)objects[i].VisibleSegments
+                  << (objects[i].Partial ? "p" : "");
+    }
+    std::cout << ", " << getSegmentationOverflows() - before << " dropped";
+    if(!ok) {
+        std::cout << " FAIL";
+        failures++;
+    }
+    std::cout << std::endl;
+}
+
+int main()
+{
+    setupGeometry();
+    setObjectSegmentationParams(0, 10000, 60, true);
+
+    const int16_t separate[16] = {
+        500, 500, 150, 148, 147, 149, 500, 500,
+        500, 500, 320, 318, 321, 500, 500, 500 };
+    const Expected separate_objects[] = {{2, 6, 4, false}, {10, 13, 3, false}};
+    check("separate", separate, separate_objects, 2, 0);
+
+    const int16_t in_front[16] = {
+        500, 300, 300, 150, 150, 300, 300, 500,
+        500, 500, 500, 500, 500, 500, 500, 500 };
+    const Expected in_front_objects[] = {{3, 5, 2, false}, {1, 7, 4, true}};
+    check("nearer object in front", in_front, in_front_objects, 2, 0);
+
+    const int16_t right_hidden[16] = {
+        500, 300, 300, 300, 150, 150, 500, 500,
+        500, 500, 500, 500, 500, 500, 500, 500 };
+    const Expected right_hidden_objects[] = {{4, 6, 2, false}, {1, 6, 3, true}};
+    check("right edge hidden", right_hidden, right_hidden_objects, 2, 0);
+
+    const int16_t left_hidden[16] = {
+        500, 150, 150, 300, 300, 300, 500, 500,
+        500, 500, 500, 500, 500, 500, 500, 500 };
+    const Expected left_hidden_objects[] = {{1, 3, 2, false}, {3, 6, 3, true}};
+    check("left edge hidden", left_hidden, left_hidden_objects, 2, 0);
+
+    const int16_t off_edge[16] = {
+        500, 500, 500, 500, 500, 500, 500, 500,
+        500, 500, 500, 500, 210, 212, 208, 211 };
+    check("runs off the right", off_edge, NULL, 0, 0);
+
+    // eight nested steps closed by one rise, then a ninth object
+    const int16_t staircase[16] = {
+        900, 800, 700, 600, 500, 400, 300, 200,
+        100, 900, 100, 900, 900, 900, 900, 900 };
+    const Expected staircase_objects[] = {
+        {8, 9, 1, false}, {7, 9, 1, true}, {6, 9, 1, true}, {5, 9, 1, true},
+        {4, 9, 1, true}, {3, 9, 1, true}, {2, 9, 1, true}, {1, 9, 1, true}};
+    check("more than 8 objects", staircase, staircase_objects, 8, 1);
+
+    // nine nested steps, deeper than the stack
+    const int16_t deep[16] = {
+        1000, 900, 800, 700, 600, 500, 400, 300,
+        200, 100, 1000, 1000, 1000, 1000, 1000, 1000 };
+    const Expected deep_objects[] = {
+        {9, 10, 1, false}, {7, 10, 1, true}, {6, 10, 1, true},
+        {5, 10, 1, true}, {4, 10, 1, true}, {3, 10, 1, true},
+        {2, 10, 1, true}, {1, 10, 1, true}};
+    check("deeper than the stack", deep, deep_objects, 8, 1);
+
+    return failures;
+}
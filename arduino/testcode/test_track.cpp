@@ -0,0 +1,516 @@
+#include <iostream>
+#include <cmath>
+#include <random>
+#include "track.h"
+#include "track_pool.h"
+#include "gyro_history.h"
+
+// Tracks simulated targets while the robot spins and reports how far the
+// track and the strike lookahead are from the truth, in both the body and
+// the world tracking frames, runs the track pool over crossing and
+// appearing targets, checks the fixed point Kalman filter against a
+// double precision one and the gyro history integral against the exact
+// rotation.
+
+static int failures = 0;
+
+static void check(const char *name, double worst, double bound)
+{
+    std::cout << name << ": worst error " << worst
+              << " (bound " << bound << ")";
+    if(worst > bound) {
+        std::cout << " FAIL";
+        failures++;
+    }
+    std::cout << std::endl;
+}
+
+// host stand-ins for the firmware services the tracking code uses
+static uint32_t fake_now = 1;
+volatile bool g_enabled = false;
+
+uint32_t micros(void) { return fake_now; }
+void digitalWrite(uint8_t pin, uint8_t val) { }
+
+struct Scenario {
+    double x, y;    // world position at t=0, mm
+    double vx, vy;  // world velocity, mm/s
+    double omega;   // body rotation, radians/s
+};
+
+// target position in the body frame at time t seconds
+static void truth(const Scenario &s, double t, double *bx, double *by)
+{
+    double wx = s.x + s.vx * t;
+    double wy = s.y + s.vy * t;
+    double h = s.omega * t;
+    *bx = wx * std::cos(h) + wy * std::sin(h);
+    *by = wy * std::cos(h) - wx * std::sin(h);
+}
+
+static double distance(double x, double y, Millimeters tx, Millimeters ty)
+{
+    return std::hypot(tx.raw() / 16.0 - x, ty.raw() / 16.0 - y);
+}
+
+// worst track and 250 ms lookahead errors once the filter has settled
+static void run(const Scenario &s, bool world_frame,
+                double *track_error, double *lookahead_error)
+{
+    const int32_t frame = 20000;
+    const int32_t swing = 250000;
+    // (2000deg/sec)/(32768 full scale)*pi/180*32768 = 34.9
+    int16_t gyro = std::lround(s.omega * 32768 / 35);
+    fake_now += 10000000;
+    Track track;
+    track.setTrackingFilterParams(9000, 8192, 3, 250000, 1000, 6000,
+                                  world_frame, false, 3000, 40, 16);
+    track.last_predict = fake_now;
+    uint32_t start = fake_now;
+    *track_error = 0;
+    *lookahead_error = 0;
+    for(int k = 0; k < 150; k++) {
+        fake_now = start + k * frame;
+        double t = k * frame / 1e6;
+        double bx, by;
+        truth(s, t, &bx, &by);
+        Object o;
+        o.X = Millimeters::fromRaw(std::lround(bx * 16));
+        o.Y = Millimeters::fromRaw(std::lround(by * 16));
+        o.Time = fake_now;
+        recordGyro(fake_now, gyro);
+        track.predict(fake_now, Radians::saturated(
+                          gyroRotation(track.last_predict, fake_now)));
+        track.update(o);
+        if(k < 50) {
+            continue;
+        }
+        Millimeters tx, ty;
+        track.bodyPosition(&tx, &ty);
+        *track_error = std::max(*track_error, distance(bx, by, tx, ty));
+        track.lookahead(swing, RadiansPerSec::fromRaw(
+                            std::lround(s.omega * 2048)), &tx, &ty);
+        truth(s, t + swing / 1e6, &bx, &by);
+        *lookahead_error = std::max(*lookahead_error,
+                                    distance(bx, by, tx, ty));
+    }
+}
+
+static void expect(const char *name, bool ok)
+{
+    std::cout << name << (ok ? "" : " FAIL") << std::endl;
+    if(!ok) {
+        failures++;
+    }
+}
+
+static Object detection(double x, double y)
+{
+    Object o;
+    o.X = Millimeters::fromRaw(std::lround(x * 16));
+    o.Y = Millimeters::fromRaw(std::lround(y * 16));
+    o.Radius = std::lround(std::hypot(x, y));
+    o.Time = fake_now;
+    return o;
+}
+
+static double trackDistance(const Track &track, double x, double y)
+{
+    return distance(x, y, track.x, track.y);
+}
+
+// two targets crossing 300 mm apart must keep their own tracks
+static void crossing()
+{
+    const int32_t frame = 20000;
+    fake_now += 10000000;
+    recordGyro(fake_now, 0);
+    TrackPool pool;
+    pool.setTrackingFilterParams(9000, 8192, 3, 250000, 1000, 6000, false,
+                                  false, 3000, 40, 16);
+    uint32_t start = fake_now;
+    int8_t track_a = -1, track_b = -1;
+    double worst = 0;
+    for(int k = 0; k < 80; k++) {
+        fake_now = start + k * frame;
+        double t = k * frame / 1e6;
+        Object objects[8];
+        objects[0] = detection(1350, -600 + 1000 * t);
+        objects[1] = detection(1650, 600 - 1000 * t);
+        pool.update(fake_now, objects, 2, MillimetersPerSec(), false);
+        if(k == 10) {
+            for(int8_t i = 0; i < MAX_TRACKS; i++) {
+                if(!pool.tracks[i].valid(fake_now)) {
+                    continue;
+                }
+                if(trackDistance(pool.tracks[i], 1350, -600 + 1000 * t) < 100) {
+                    track_a = i;
+                } else {
+                    track_b = i;
+                }
+            }
+        }
+        if(k > 10 && track_a >= 0 && track_b >= 0) {
+            worst = std::max(worst, trackDistance(pool.tracks[track_a],
+                                                  1350, -600 + 1000 * t));
+            worst = std::max(worst, trackDistance(pool.tracks[track_b],
+                                                  1650, 600 - 1000 * t));
+        }
+    }
+    expect("crossing: two tracks", track_a >= 0 && track_b >= 0 &&
+                                   pool.numValid(fake_now) == 2);
+    check("crossing: track on its own target (mm)", worst, 100);
+}
+
+// a nearer target appearing does not take the primary, losing the
+// primary's target hands over to the nearest valid track
+static void appearing(bool closest_only)
+{
+    const int32_t frame = 20000;
+    fake_now += 10000000;
+    recordGyro(fake_now, 0);
+    TrackPool pool;
+    pool.setTrackingFilterParams(9000, 8192, 3, 250000, 1000, 6000, false,
+                                  false, 3000, 40, 16);
+    uint32_t start = fake_now;
+    int8_t first = -1, second = -1;
+    bool kept = true;
+    for(int k = 0; k < 60; k++) {
+        fake_now = start + k * frame;
+        Object objects[8];
+        uint8_t n = 0;
+        if(k < 40) {
+            objects[n++] = detection(2000, 0);
+        }
+        if(k >= 10) {
+            objects[n++] = detection(800, 300);
+        }
+        pool.update(fake_now, objects, n, MillimetersPerSec(), closest_only);
+        if(k == 9) {
+            first = pool.primary;
+        }
+        if(k >= 20 && k < 40 && pool.primary != first) {
+            kept = false;
+            second = pool.primary;
+        }
+        if(k == 59 && pool.primary != first) {
+            second = pool.primary;
+        }
+    }
+    if(closest_only) {
+        expect("closest only: nearer target takes the primary",
+               first >= 0 && second >= 0 && !kept);
+    } else {
+        expect("sticky: primary kept while valid", first >= 0 && kept);
+        expect("sticky: primary handed over when lost",
+               second >= 0 && second != first &&
+               trackDistance(pool.primaryTrack(), 800, 300) < 20);
+    }
+}
+
+// a detection outside max_off_track of a track starts another one
+static void gating()
+{
+    fake_now += 10000000;
+    recordGyro(fake_now, 0);
+    TrackPool pool;
+    pool.setTrackingFilterParams(9000, 8192, 3, 250000, 500, 6000, false,
+                                  false, 3000, 40, 16);
+    Object objects[8];
+    for(int k = 0; k < 6; k++) {
+        fake_now += 20000;
+        objects[0] = detection(1000, 0);
+        pool.update(fake_now, objects, 1, MillimetersPerSec(), false);
+    }
+    fake_now += 20000;
+    objects[0] = detection(1000, 800);
+    pool.update(fake_now, objects, 1, MillimetersPerSec(), false);
+    int live = 0;
+    for(int8_t i = 0; i < MAX_TRACKS; i++) {
+        live += pool.tracks[i].recent_update(fake_now);
+    }
+    expect("gating: jump starts a new track",
+           live == 2 && trackDistance(pool.primaryTrack(), 1000, 0) < 20);
+}
+
+// one axis of a double precision constant velocity Kalman filter
+struct ReferenceAxis {
+    double p, v, pp, pv, vv;
+
+    void start(double z, double r) {
+        p = z;
+        v = 0;
+        pp = r;
+        pv = 0;
+        vv = 4e6;
+    }
+    void predict(double dt, double q) {
+        p += v * dt;
+        pp += 2 * dt * pv + dt * dt * vv + q * std::pow(dt, 4) / 4;
+        pv += dt * vv + q * std::pow(dt, 3) / 2;
+        vv += q * dt * dt;
+    }
+    void update(double z, double r) {
+        double s = pp + r;
+        double kp = pp / s;
+        double kv = pv / s;
+        double residual = z - p;
+        p += kp * residual;
+        v += kv * residual;
+        vv -= kv * pv;
+        pp -= kp * pp;
+        pv -= kp * pv;
+    }
+};
+
+// noisy detections of a moving target at irregular frame intervals
+static void kalman()
+{
+    const double r = 40 * 40;
+    const double q = 3000.0 * 3000.0;
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0, 40);
+    std::uniform_int_distribution<int> jitter(20000, 100000);
+    fake_now += 10000000;
+    Track track;
+    track.setTrackingFilterParams(9000, 8192, 3, 250000, 1000, 6000, false,
+                                  true, 3000, 40, 16);
+    Track alpha_beta;
+    alpha_beta.setTrackingFilterParams(9000, 8192, 3, 250000, 1000, 6000,
+                                       false, false, 3000, 40, 16);
+    track.last_predict = alpha_beta.last_predict = fake_now;
+    ReferenceAxis rx, ry;
+    double t = 0;
+    double position = 0, velocity = 0, kalman_error = 0, alpha_beta_error = 0;
+    for(int k = 0; k < 200; k++) {
+        int32_t dt = jitter(rng);
+        fake_now += dt;
+        t += dt / 1e6;
+        double x = 1200 + 800 * t, y = 500 - 300 * t;
+        if(x > 3000) {
+            x = 6000 - x;
+        }
+        Object o = detection(x + noise(rng), y + noise(rng));
+        track.predict(fake_now, Radians());
+        track.update(o);
+        alpha_beta.predict(fake_now, Radians());
+        alpha_beta.update(o);
+        double zx = o.X.raw() / 16.0, zy = o.Y.raw() / 16.0;
+        if(k == 0) {
+            rx.start(zx, r);
+            ry.start(zy, r);
+        } else {
+            rx.predict(dt / 1e6, q);
+            ry.predict(dt / 1e6, q);
+            rx.update(zx, r);
+            ry.update(zy, r);
+        }
+        if(k < 20) {
+            continue;
+        }
+        position = std::max(position, distance(rx.p, ry.p, track.x, track.y));
+        velocity = std::max(velocity, distance(rx.v, ry.v, track.vx, track.vy));
+        kalman_error += std::pow(distance(x, y, track.x, track.y), 2);
+        alpha_beta_error += std::pow(distance(x, y, alpha_beta.x,
+                                              alpha_beta.y), 2);
+    }
+    check("Kalman vs double precision x/y (mm)", position, 2);
+    check("Kalman vs double precision vx/vy (mm/s)", velocity, 20);
+    std::cout << "rms error, Kalman " << std::sqrt(kalman_error / 180)
+              << " mm, alpha-beta " << std::sqrt(alpha_beta_error / 180)
+              << " mm" << std::endl;
+
+    Object near = detection(track.x.raw() / 16.0 + 30, track.y.raw() / 16.0);
+    Object far = detection(track.x.raw() / 16.0 + 300, track.y.raw() / 16.0);
+    expect("Kalman gate passes a 30mm innovation",
+           track.gated(near, track.distanceSq(near)));
+    expect("Kalman gate rejects a 300mm innovation",
+           !track.gated(far, track.distanceSq(far)));
+}
+
+// A consistent Kalman filter on a constant velocity target has zero mean
+// innovations and a mean normalized innovation squared of 2, one per axis.
+static void innovationStats()
+{
+    std::mt19937 rng(2);
+    std::normal_distribution<double> noise(0, 40);
+    fake_now += 10000000;
+    Track track;
+    track.setTrackingFilterParams(9000, 8192, 3, 250000, 1000, 6000, false,
+                                  true, 3000, 40, 16);
+    track.last_predict = fake_now;
+    uint32_t start = fake_now;
+    for(int k = 0; k < 300; k++) {
+        if(k == 30) {
+            expect("innovation stats: one reset", track.innovations.resets == 1);
+            track.innovations.clear();
+        }
+        fake_now = start + k * 40000;
+        double t = k * 0.04;
+        Object o = detection(1000 + 300 * t + noise(rng),
+                             -1500 + 200 * t + noise(rng));
+        track.predict(fake_now, Radians());
+        track.update(o);
+    }
+    const InnovationStats &stats = track.innovations;
+    double n = stats.count;
+    double mean_x = stats.sum_rx / n, mean_y = stats.sum_ry / n;
+    double var_x = stats.sum_rx2 / n - mean_x * mean_x;
+    double nis = stats.sum_nis / n / 16;
+    std::cout << "innovations: " << n << " updates, mean " << mean_x << ", "
+              << mean_y << " mm, x variance " << var_x << " mm^2, NIS "
+              << nis << std::endl;
+    expect("innovation stats: count stops at 255", stats.count == 255);
+    expect("innovation stats: zero mean",
+           std::fabs(mean_x) < 10 && std::fabs(mean_y) < 10);
+    expect("innovation stats: variance above the detection noise",
+           var_x > 1600 && var_x < 4000);
+    expect("innovation stats: consistent NIS", nis > 1.4 && nis < 2.8);
+    expect("innovation stats: no resets", stats.resets == 0);
+}
+
+// Rotation over LEDDAR frame sized intervals from 10ms gyro samples of a
+// weaving robot, against the exact integral and the previous estimate of
+// the mean of the two latest samples times dt.
+static void gyroIntegral()
+{
+    // (2000deg/sec)/(32768 full scale)*pi/180*2048 = 35/16 per count
+    const double counts_per_radian = 2048 * 16 / 35.0;
+    fake_now += 10000000;
+    uint32_t start = fake_now;
+    // omega = 8 sin(4t) radians/s, turned = 2 (1 - cos(4t))
+    double worst = 0, two_point = 0;
+    int16_t previous = 0, latest = 0;
+    uint32_t t0 = start;
+    for(int k = 0; k <= 300; k++) {
+        uint32_t now = start + k * 10000;
+        double t = k * 0.01;
+        previous = latest;
+        latest = std::lround(8 * std::sin(4 * t) * counts_per_radian);
+        recordGyro(now, latest);
+        if(k % 5 != 0 || k == 0) {
+            continue;
+        }
+        // a frame every 50ms, 3ms after the gyro read
+        uint32_t t1 = now + 3000;
+        double exact = 2 * (std::cos(4 * ((t0 - start) / 1e6)) -
+                            std::cos(4 * ((t1 - start) / 1e6))) * 2048;
+        if(k > 5) {
+            worst = std::max(worst, std::fabs(gyroRotation(t0, t1) - exact));
+            double estimate = (previous + latest) / 2.0 / counts_per_radian *
+                              (t1 - t0) / 1e6 * 2048;
+            two_point = std::max(two_point, std::fabs(estimate - exact));
+        }
+        t0 = t1;
+    }
+    std::cout << "two sample estimate: worst error " << two_point
+              << " radians*2048" << std::endl;
+    check("gyro history rotation (radians*2048)", worst, 3);
+}
+
+// predictAt extrapolates a copy, the filter itself does not move
+static void predictAt()
+{
+    fake_now += 10000000;
+    recordGyro(fake_now, 0);
+    Track track;
+    track.setTrackingFilterParams(9000, 8192, 3, 250000, 1000, 6000, true,
+                                  true, 3000, 40, 16);
+    track.last_predict = fake_now;
+    track.x = Millimeters::fromInt(1000);
+    track.vx = MillimetersPerSec::fromInt(-500);
+    track.cx.pp = 400;
+    // turning at 2 radians/s
+    const int16_t gyro = std::lround(2 * 2048 * 16 / 35.0);
+    recordGyro(fake_now + 10000, gyro);
+    recordGyro(fake_now + 20000, gyro);
+    Track before = track;
+    Track current = track.predictAt(fake_now + 20000);
+    Track predicted = track;
+    predicted.predict(fake_now + 20000, Radians::saturated(
+                          gyroRotation(track.last_predict, fake_now + 20000)));
+    expect("predictAt leaves the filter alone",
+           track.x == before.x && track.last_predict == before.last_predict &&
+           track.heading == before.heading && track.cx.pp == before.cx.pp);
+    expect("predictAt matches predict",
+           current.x == predicted.x && current.y == predicted.y &&
+           current.heading == predicted.heading &&
+           current.x == Millimeters::fromInt(990));
+}
+
+// driving at a still target, the track velocity stays the target's own
+static void egoMotion()
+{
+    const int32_t frame = 20000;
+    const MillimetersPerSec ego = MillimetersPerSec::fromInt(1000);
+    fake_now += 10000000;
+    recordGyro(fake_now, 0);
+    Track track;
+    track.setTrackingFilterParams(9000, 8192, 3, 250000, 1000, 6000, false,
+                                  false, 3000, 40, 16);
+    track.last_predict = fake_now;
+    uint32_t start = fake_now;
+    double worst = 0;
+    for(int k = 0; k < 100; k++) {
+        fake_now = start + k * frame;
+        Object o = detection(3000 - 1000 * (k * frame / 1e6), 200);
+        track.predict(fake_now, Radians(), ego);
+        track.update(o);
+        if(k > 30) {
+            worst = std::max(worst, std::hypot(track.vx.raw() / 16.0,
+                                               track.vy.raw() / 16.0));
+        }
+    }
+    MillimetersPerSec rvx, rvy;
+    track.relativeVelocity(&rvx, &rvy);
+    check("ego motion: still target speed (mm/s)", worst, 5);
+    expect("ego motion: closing at our speed",
+           std::fabs(rvx.raw() / 16.0 + 1000) < 5);
+}
+
+// a new track is lost under the last lost track interval set, not a fixed one
+static void startsLost()
+{
+    fake_now += 10000000;
+    Track track;
+    track.setTrackingFilterParams(9000, 8192, 3, 500000, 1000, 6000, false,
+                                  false, 3000, 40, 16);
+    Track fresh;
+    expect("new track: lost under a longer interval",
+           !fresh.recent_update(fake_now));
+    track.setTrackingFilterParams(9000, 8192, 3, 250000, 1000, 6000, false,
+                                  false, 3000, 40, 16);
+}
+
+int main()
+{
+    const Scenario scenarios[] = {
+        {1500, 300, 0, 0, 0},
+        {1500, 300, 0, 0, 10},
+        {1500, 300, -600, 200, 10},
+        {1000, -400, 0, 0, -25},
+    };
+    const char *names[] = {"still", "spinning, still target",
+                           "spinning, moving target", "fast spin"};
+    for(int i = 0; i < 4; i++) {
+        double body_track, body_lookahead, world_track, world_lookahead;
+        run(scenarios[i], false, &body_track, &body_lookahead);
+        run(scenarios[i], true, &world_track, &world_lookahead);
+        std::cout << names[i] << ": body frame track " << body_track
+                  << " mm, lookahead " << body_lookahead << " mm" << std::endl;
+        std::string name = std::string(names[i]) + ", world frame";
+        check((name + " track (mm)").c_str(), world_track, 5);
+        check((name + " lookahead (mm)").c_str(), world_lookahead, 20);
+    }
+    crossing();
+    appearing(false);
+    appearing(true);
+    gating();
+    kalman();
+    innovationStats();
+    gyroIntegral();
+    predictAt();
+    egoMotion();
+    startsLost();
+    return failures;
+}